@@ -1,4 +1,5 @@
 #include <gmock/gmock.h>
+#include "HeapTracking.h"
 #include <type_traits>
 #include <functional>
 #include <memory>
@@ -70,4 +71,28 @@ TEST(FigureTests, cloning_rvalue)
     ASSERT_TRUE((std::is_same<Square*, decltype(figure)>::value));
 }
 
+struct FigureHeapTests : HeapTracking {};
+
+TEST_F(FigureHeapTests, square_clone_makes_one_allocation)
+{
+    auto square = Square{};
+    const Figure& figure = square;
+
+    std::unique_ptr<Figure> copy{figure.clone()};
+
+    ASSERT_THAT(allocations(), Eq(1u));
+}
+
+TEST_F(FigureHeapTests, deleting_clone_releases_its_allocation)
+{
+    auto square = Square{};
+    static Figure* volatile escaped = nullptr;  // clone escapes through it, so new/delete pair cannot be elided
+
+    escaped = square.clone();
+    delete escaped;
+
+    ASSERT_THAT(allocations(), Eq(1u));
+    ASSERT_THAT(deallocations(), Eq(allocations()));
+}
+
 } // v1 namespace
@@ -1,4 +1,5 @@
 #include <gmock/gmock.h>
+#include "HeapTracking.h"
 #include <type_traits>
 #include <functional>
 #include <memory>
@@ -86,4 +87,16 @@ TEST(FigureTests_v2, clonning_const_figure)
     ASSERT_TRUE((std::is_same<std::unique_ptr<Square>, decltype(figure)>::value));
 }
 
+struct FigureHeapTests_v2 : HeapTracking {};
+
+TEST_F(FigureHeapTests_v2, clone_into_unique_ptr_makes_one_allocation)
+{
+    auto square = Square{};
+    const Figure& figure = square;
+
+    auto copy = clone(figure);
+
+    ASSERT_THAT(allocations(), Eq(1u));
+}
+
 } // v2 namespace
@@ -1,4 +1,5 @@
 #include <gmock/gmock.h>
+#include "HeapTracking.h"
 #include <type_traits>
 #include <functional>
 #include <memory>
@@ -98,4 +99,16 @@ TEST(FigureTests_v3, cloned_square_via_const_pointer)
     ASSERT_TRUE((std::is_same<std::unique_ptr<Square>, decltype(figure)>::value));
 }
 
+struct FigureHeapTests_v3 : HeapTracking {};
+
+TEST_F(FigureHeapTests_v3, clone_via_const_pointer_makes_one_allocation)
+{
+    auto square = Square{};
+    const Figure* figure = &square;
+
+    auto copy = object::clone(figure);
+
+    ASSERT_THAT(allocations(), Eq(1u));
+}
+
 } // v3 namespace
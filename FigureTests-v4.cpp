@@ -1,4 +1,5 @@
 #include <gmock/gmock.h>
+#include "HeapTracking.h"
 #include <type_traits>
 #include <functional>
 #include <memory>
@@ -96,4 +97,16 @@ TEST(FigureTests_v4, clonning_rvalue)
     ASSERT_TRUE((std::is_same<std::unique_ptr<Square>, decltype(figure)>::value));
 }
 
+struct FigureHeapTests_v4 : HeapTracking {};
+
+TEST_F(FigureHeapTests_v4, clone_via_base_pointer_makes_one_allocation)
+{
+    auto square = Square{};
+    auto figure = static_cast<Figure*>(&square);
+
+    auto copy = object::clone(figure);
+
+    ASSERT_THAT(allocations(), Eq(1u));
+}
+
 } // v4 namespace
@@ -1,62 +1,31 @@
 #include <gmock/gmock.h>
-#include <type_traits>
-#include <functional>
-#include <memory>
+#include "HeapTracking.h"
+#include "Figures-v5.h"
+#include <chrono>
 
 namespace v5 {
 
-namespace object
+struct counting_resource : std::pmr::memory_resource
 {
-    template<typename T>
-    std::unique_ptr<T> clone(const T& object)
-    {
-        using base_type = typename T::base_type;
-        static_assert(std::is_base_of<base_type, T>::value, "T object has to derived from T::base_type");
-        auto ptr = static_cast<const base_type&>(object).clone();
-        return std::unique_ptr<T>(static_cast<T*>(ptr));
-    }
+    int allocations   = 0;
+    int deallocations = 0;
 
-    template<typename T>
-    auto clone(T* object) -> decltype(clone(*object))
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override
     {
-        return clone(*object);
+        ++allocations;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
     }
 
-    template<typename T>
-    struct cloneable
-    {
-        using base_type = T;
-
-        virtual ~cloneable() = default;
-    protected:
-        virtual T* clone() const = 0;
-
-        template <typename X>
-        friend std::unique_ptr<X> object::clone(const X&);
-    };
-}
-
-struct Figure : object::cloneable<Figure>
-{
-    virtual double  area()  const = 0;
-};
-
-struct Square : Figure
-{
-    double a = 0;
-
-    Square() = default;
-    Square(double a) : a{a}{}
-
-    double  area()  const override
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override
     {
-        return a * a;
+        ++deallocations;
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
     }
 
-protected:
-    Square* clone() const override     // return type is Square* instead of Figure* (Covariant Return Type)
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
     {
-        return new Square(*this);
+        return this == &other;
     }
 };
 
@@ -70,6 +39,39 @@ TEST(FigureTests_v5, square_clone_method_called_directly_return_pointer_of_type_
     ASSERT_TRUE((std::is_same<std::unique_ptr<Square>, decltype(figure)>::value));
 }
 
+TEST(FigureTests_v5, final_square_clone_method_called_directly_return_pointer_of_type_FinalSquare_without_virtual_call)
+{
+    auto square = FinalSquare{};
+    FinalSquare::virtual_clones = 0;
+    auto figure = object::clone(square);
+
+    ASSERT_TRUE((std::is_same<std::unique_ptr<FinalSquare>, decltype(figure)>::value));
+    ASSERT_THAT(FinalSquare::virtual_clones, Eq(0));
+}
+
+TEST(FigureTests_v5, final_square_cloned_directly_and_via_base_class_has_same_type_and_area)
+{
+    auto a = 4.;
+    auto square = FinalSquare{a};
+    auto direct  = object::clone(square);
+    auto virtual_call = object::clone(static_cast<Square&>(square));
+
+    ASSERT_TRUE(typeid(*direct) == typeid(*virtual_call));
+    ASSERT_THAT(direct->area(), Eq(virtual_call->area()));
+    ASSERT_THAT(direct->area(), Eq(a*a));
+}
+
+TEST(FigureTests_v5, final_square_cloned_with_memory_resource_without_virtual_call)
+{
+    std::pmr::monotonic_buffer_resource arena;
+    auto square = FinalSquare{2.};
+    FinalSquare::virtual_clones = 0;
+    object::resource_ptr<const Figure> figure = object::clone(static_cast<const FinalSquare*>(&square), arena);
+
+    ASSERT_THAT(FinalSquare::virtual_clones, Eq(0));
+    ASSERT_THAT(figure->area(), Eq(square.area()));
+}
+
 TEST(FigureTests_v5, square_clone_method_called_via_base_class_return_pointer_of_type_Figure)
 {
     auto square = Square{};
@@ -98,4 +100,1519 @@ TEST(FigureTests_v5, clonning_rvalue)
     ASSERT_TRUE((std::is_same<std::unique_ptr<Square>, decltype(figure)>::value));
 }
 
+TEST(FigureTests_v5, clonning_rvalue_moves_state_into_clone)
+{
+    auto polygon  = Polygon{{{0, 0}, {2, 0}, {2, 2}, {0, 2}}};
+    auto vertices = polygon.vertices.data();
+    auto figure   = object::clone(std::move(polygon));
+
+    ASSERT_TRUE((std::is_same<std::unique_ptr<Polygon>, decltype(figure)>::value));
+    ASSERT_THAT(figure->vertices.data(), Eq(vertices));
+    ASSERT_THAT(figure->area(), Eq(4.));
+}
+
+TEST(FigureTests_v5, clonning_rvalue_via_base_class_moves_dynamic_type)
+{
+    auto polygon = Polygon{{{0, 0}, {3, 0}, {0, 3}}};
+    auto figure  = object::clone(std::move(static_cast<Figure&>(polygon)));
+
+    ASSERT_TRUE((std::is_same<std::unique_ptr<Figure>, decltype(figure)>::value));
+    ASSERT_THAT(figure->area(), Eq(4.5));
+    ASSERT_TRUE(polygon.vertices.empty());
+}
+
+TEST(FigureTests_v5, clonning_lvalue_still_copies)
+{
+    auto polygon = Polygon{{{0, 0}, {3, 0}, {0, 3}}};
+    auto figure  = object::clone(polygon);
+
+    ASSERT_THAT(figure->vertices.size(), Eq(polygon.vertices.size()));
+    ASSERT_THAT(figure->vertices.data(), Ne(polygon.vertices.data()));
+}
+
+TEST(FigureTests_v5, square_cloned_with_memory_resource_return_pointer_of_type_Square)
+{
+    std::pmr::monotonic_buffer_resource arena;
+    auto square = Square{};
+    auto figure = object::clone(square, arena);
+
+    ASSERT_TRUE((std::is_same<object::resource_ptr<Square>, decltype(figure)>::value));
+}
+
+TEST(FigureTests_v5, square_cloned_with_memory_resource_via_base_class_return_pointer_of_type_Figure)
+{
+    std::pmr::monotonic_buffer_resource arena;
+    auto square = Square{};
+    auto square_figure = static_cast<Figure*>(&square);
+    auto figure = object::clone(square_figure, arena);
+
+    ASSERT_TRUE((std::is_same<object::resource_ptr<Figure>, decltype(figure)>::value));
+}
+
+TEST(FigureTests_v5, cloned_square_with_memory_resource_should_return_same_area)
+{
+    std::pmr::monotonic_buffer_resource arena;
+    auto a = 4.;
+    auto square = Square{a};
+    auto figure = object::clone(static_cast<Figure*>(&square), arena);
+
+    ASSERT_THAT(figure->area(), Eq(square.area()));
+}
+
+TEST(FigureTests_v5, square_cloned_with_memory_resource_lives_in_resource_buffer)
+{
+    alignas(Square) unsigned char buffer[64];
+    std::pmr::monotonic_buffer_resource arena{buffer, sizeof(buffer), std::pmr::null_memory_resource()};
+    auto figure = object::clone(Square{2.}, arena);
+
+    auto address = reinterpret_cast<unsigned char*>(figure.get());
+    ASSERT_TRUE(address >= buffer && address < buffer + sizeof(buffer));
+}
+
+TEST(FigureTests_v5, square_cloned_with_memory_resource_is_given_back_to_same_resource)
+{
+    counting_resource resource;
+    {
+        auto square = Square{};
+        object::resource_ptr<Figure> figure = object::clone(square, resource);
+
+        ASSERT_THAT(resource.allocations, Eq(1));
+        ASSERT_THAT(resource.deallocations, Eq(0));
+    }
+    ASSERT_THAT(resource.deallocations, Eq(1));
+}
+
+TEST(FigureTests_v5, pooled_square_clone_return_pointer_of_type_PooledSquare)
+{
+    auto square = PooledSquare<object::shared_pool>{};
+    auto figure = object::clone(square);
+
+    ASSERT_TRUE((std::is_same<std::unique_ptr<PooledSquare<object::shared_pool>>, decltype(figure)>::value));
+}
+
+TEST(FigureTests_v5, pooled_square_clone_reuses_recycled_slot)
+{
+    auto a = 3.;
+    auto square = PooledSquare<object::shared_pool>{a};
+    auto figure = object::clone(square);
+    auto address = static_cast<void*>(figure.get());
+    figure.reset();
+
+    std::unique_ptr<Figure> recycled = object::clone(square);
+
+    ASSERT_THAT(static_cast<void*>(recycled.get()), Eq(address));
+    ASSERT_THAT(recycled->area(), Eq(a*a));
+}
+
+TEST(FigureTests_v5, thread_local_pooled_square_does_not_share_slots_between_threads)
+{
+    auto square = PooledSquare<object::thread_local_pool>{};
+    auto figure = object::clone(square);
+    auto address = static_cast<void*>(figure.get());
+    figure.reset();
+
+    void* other_thread_address = nullptr;
+    std::thread{[&]{ other_thread_address = object::clone(square).get(); }}.join();
+
+    ASSERT_THAT(other_thread_address, Ne(address));
+    ASSERT_THAT(static_cast<void*>(object::clone(square).get()), Eq(address));
+}
+
+TEST(FigureTests_v5, clone_all_figures_return_pointers_of_type_Figure_with_same_area)
+{
+    std::vector<std::unique_ptr<Figure>> figures;
+    figures.emplace_back(new Square{1.});
+    figures.emplace_back(new FinalSquare{2.});
+    figures.emplace_back(new Square{3.});
+
+    std::vector<std::unique_ptr<Figure>> copies;
+    object::clone_all(figures.begin(), figures.end(), std::back_inserter(copies));
+
+    ASSERT_THAT(copies.size(), Eq(figures.size()));
+    for (auto i = 0u; i < figures.size(); ++i)
+    {
+        ASSERT_THAT(copies[i].get(), Ne(figures[i].get()));
+        ASSERT_THAT(copies[i]->area(), Eq(figures[i]->area()));
+    }
+}
+
+TEST(FigureTests_v5, clone_all_final_squares_return_pointers_of_type_FinalSquare)
+{
+    FinalSquare squares[] = {FinalSquare{1.}, FinalSquare{2.}};
+    const FinalSquare* pointers[] = {&squares[0], &squares[1]};
+
+    std::vector<std::unique_ptr<FinalSquare>> copies;
+    object::clone_all(std::begin(pointers), std::end(pointers), std::back_inserter(copies));
+
+    ASSERT_THAT(copies[0]->area(), Eq(squares[0].area()));
+    ASSERT_THAT(copies[1]->area(), Eq(squares[1].area()));
+}
+
+TEST(FigureTests_v5, clone_all_with_memory_resource_allocates_once_per_dynamic_type)
+{
+    std::vector<std::unique_ptr<Figure>> figures;
+    figures.emplace_back(new Square{1.});
+    figures.emplace_back(new Square{2.});
+    figures.emplace_back(new FinalSquare{3.});
+    figures.emplace_back(new FinalSquare{4.});
+    figures.emplace_back(new Square{5.});
+
+    counting_resource resource;
+    {
+        std::vector<object::resource_ptr<Figure>> copies;
+        object::clone_all(figures.begin(), figures.end(), std::back_inserter(copies), resource);
+
+        ASSERT_THAT(resource.allocations, Eq(2));
+        ASSERT_THAT(reinterpret_cast<char*>(copies[1].get()) - reinterpret_cast<char*>(copies[0].get()), Eq(static_cast<std::ptrdiff_t>(sizeof(Square))));
+        for (auto i = 0u; i < figures.size(); ++i)
+            ASSERT_THAT(copies[i]->area(), Eq(figures[i]->area()));
+    }
+    ASSERT_THAT(resource.deallocations, Eq(2));
+}
+
+TEST(FigureTests_v5, clone_all_of_alternating_types_allocates_once_per_dynamic_type)
+{
+    std::vector<std::unique_ptr<Figure>> figures;
+    for (auto i = 0; i < 100; ++i)
+        figures.emplace_back(i % 2 ? static_cast<Figure*>(new Square(i)) : new FinalSquare(i));
+
+    counting_resource resource;
+    {
+        std::vector<object::resource_ptr<Figure>> copies;
+        object::clone_all(figures.begin(), figures.end(), std::back_inserter(copies), resource);
+
+        ASSERT_THAT(resource.allocations, Eq(2));
+    }
+    ASSERT_THAT(resource.deallocations, Eq(2));
+}
+
+std::vector<std::unique_ptr<Figure>> make_squares(std::size_t count)
+{
+    std::vector<std::unique_ptr<Figure>> figures;
+    for (auto i = 0u; i < count; ++i)
+        figures.emplace_back(new Square(i));
+    return figures;
+}
+
+TEST(FigureTests_v5, parallel_clone_all_keeps_source_order)
+{
+    auto figures = make_squares(1000);
+    auto policy  = object::parallel_policy{4, 64};
+
+    std::vector<std::unique_ptr<Figure>> copies(figures.size());
+    auto end = object::clone_all(policy, figures.begin(), figures.end(), copies.begin());
+
+    ASSERT_TRUE(end == copies.end());
+    for (auto i = 0u; i < figures.size(); ++i)
+        ASSERT_THAT(copies[i]->area(), Eq(figures[i]->area()));
+}
+
+TEST(FigureTests_v5, parallel_clone_all_with_memory_resources_allocates_from_worker_resources_only)
+{
+    auto figures = make_squares(1000);
+    auto policy  = object::parallel_policy{0, 100};
+    counting_resource resources[4];
+    {
+        std::vector<object::resource_ptr<Figure>> copies(figures.size());
+        object::clone_all(policy, figures.begin(), figures.end(), copies.begin(), resources);
+
+        auto allocations = 0;
+        for (auto& resource : resources)
+            allocations += resource.allocations;
+        ASSERT_THAT(allocations, Eq(10));   // one run per chunk
+        for (auto i = 0u; i < figures.size(); ++i)
+            ASSERT_THAT(copies[i]->area(), Eq(figures[i]->area()));
+    }
+}
+
+// runs queued tasks when asked - lets tests observe future before clone runs
+struct queue_executor
+{
+    std::vector<std::function<void()>> tasks;
+
+    void operator()(std::function<void()> task)
+    {
+        tasks.push_back(std::move(task));
+    }
+
+    void run()
+    {
+        for (auto& task : tasks)
+            task();
+        tasks.clear();
+    }
+};
+
+TEST(FigureTests_v5, clone_async_square_yields_future_of_Square)
+{
+    auto square = Square{2.};
+    queue_executor executor;
+
+    auto future = object::clone_async(square, std::ref(executor));
+
+    ASSERT_TRUE((std::is_same<std::future<std::unique_ptr<Square>>, decltype(future)>::value));
+    ASSERT_THAT(future.wait_for(std::chrono::seconds(0)), Eq(std::future_status::timeout));
+    executor.run();
+    ASSERT_THAT(future.get()->area(), Eq(4.));
+}
+
+TEST(FigureTests_v5, clone_async_by_figure_pointer_yields_future_of_Figure)
+{
+    auto square = Square{3.};
+    auto figure = static_cast<Figure*>(&square);
+
+    auto future = object::clone_async(figure);
+
+    ASSERT_TRUE((std::is_same<std::future<std::unique_ptr<Figure>>, decltype(future)>::value));
+    auto copy = future.get();
+    ASSERT_TRUE(typeid(*copy) == typeid(Square));
+    ASSERT_THAT(copy->area(), Eq(9.));
+}
+
+TEST(FigureTests_v5, parallel_clone_all_with_zero_chunk_size_uses_default_chunks)
+{
+    auto figures = make_squares(10);
+    std::vector<std::unique_ptr<Figure>> copies(figures.size());
+
+    object::clone_all(object::parallel_policy{2, 0}, figures.begin(), figures.end(), copies.begin());
+
+    for (auto i = 0u; i < figures.size(); ++i)
+        ASSERT_THAT(copies[i]->area(), Eq(figures[i]->area()));
+}
+
+TEST(FigureTests_v5, parallel_clone_all_with_no_resources_uses_default_resource)
+{
+    auto figures = make_squares(10);
+    std::vector<object::resource_ptr<Figure>> copies(figures.size());
+    std::vector<std::pmr::memory_resource*> resources;
+
+    object::clone_all(object::par, figures.begin(), figures.end(), copies.begin(), resources);
+
+    for (auto i = 0u; i < figures.size(); ++i)
+        ASSERT_THAT(copies[i]->area(), Eq(figures[i]->area()));
+}
+
+TEST(FigureTests_v5, empty_figure_store_has_no_area)
+{
+    FigureStore store;
+
+    ASSERT_THAT(store.size(), Eq(0u));
+    ASSERT_THAT(store.total_area(), Eq(0.));
+}
+
+TEST(FigureTests_v5, figure_store_total_area_is_sum_of_figure_areas)
+{
+    FigureStore store;
+    auto expected = 0.;
+    for (auto a = 1; a <= 19; ++a)
+    {
+        store.add(Square(a));
+        expected += Square(a).area();
+    }
+
+    ASSERT_THAT(store.size(), Eq(19u));
+    ASSERT_THAT(store.total_area(), Eq(expected));
+}
+
+TEST(FigureTests_v5, figure_store_areas_are_same_as_figure_areas)
+{
+    FigureStore store;
+    for (auto a = 1; a <= 19; ++a)
+        store.add(Square(a / 2.));
+
+    std::vector<double> areas(store.size());
+    store.areas(areas.data());
+
+    for (auto i = 0u; i < areas.size(); ++i)
+        ASSERT_THAT(areas[i], Eq(Square((i + 1) / 2.).area()));
+}
+
+TEST(FigureTests_v5, figure_store_kernels_supported_by_cpu_agree_with_scalar_kernel)
+{
+    FigureStore store;
+    for (auto a = 1; a <= 19; ++a)
+        store.add(Square(a / 2.));
+    std::vector<double> expected(store.size());
+    store.areas(expected.data(), FigureStore::kernel::scalar);
+
+    for (auto used : {FigureStore::kernel::avx2, FigureStore::kernel::avx512})
+    {
+        if (!FigureStore::supports(used))
+            continue;
+        std::vector<double> areas(store.size());
+        store.areas(areas.data(), used);
+
+        ASSERT_THAT(areas, Eq(expected));
+        ASSERT_THAT(store.total_area(used), DoubleEq(store.total_area(FigureStore::kernel::scalar)));
+    }
+}
+
+TEST(FigureTests_v5, copy_of_poly_value_of_Square_has_type_Square)
+{
+    auto square = object::poly_value<Square>{Square{}};
+    auto figure = square;
+
+    ASSERT_TRUE((std::is_same<Square&, decltype(*figure)>::value));
+}
+
+TEST(FigureTests_v5, copy_of_poly_value_of_Figure_has_same_area)
+{
+    auto a = 4.;
+    auto square = object::poly_value<Figure>{Square{a}};
+    auto figure = square;
+
+    ASSERT_TRUE((std::is_same<Figure&, decltype(*figure)>::value));
+    ASSERT_THAT(figure.get(), Ne(square.get()));
+    ASSERT_THAT(figure->area(), Eq(a*a));
+}
+
+TEST(FigureTests_v5, small_figure_in_poly_value_is_kept_inline)
+{
+    auto square = object::poly_value<Figure>{Square{2.}};
+    auto figure = square;
+    auto moved  = std::move(figure);
+
+    ASSERT_TRUE(square.is_inline());
+    ASSERT_TRUE(moved.is_inline());
+    ASSERT_FALSE(figure);
+    ASSERT_THAT(moved->area(), Eq(square->area()));
+}
+
+TEST(FigureTests_v5, poly_value_adopting_pointer_is_copied_via_clone)
+{
+    auto a = 3.;
+    auto square = object::poly_value<Figure>{object::clone(Square{a})};
+    auto figure = square;
+
+    ASSERT_FALSE(figure.is_inline());
+    ASSERT_THAT(figure.get(), Ne(square.get()));
+    ASSERT_THAT(figure->area(), Eq(a*a));
+}
+
+#if defined(OBJECT_CLONE_INSTRUMENTATION)
+TEST(FigureTests_v5, instrumentation_counts_clones_per_dynamic_type)
+{
+    object::instrumentation::reset();
+    auto square = Square{};
+    auto square_figure = static_cast<Figure*>(&square);
+    auto figure = object::clone(square_figure);
+    auto copy   = object::clone(square);
+
+    auto stats = object::instrumentation::snapshot();
+
+    ASSERT_THAT(stats.size(), Eq(1u));
+    ASSERT_TRUE(stats[0].type == typeid(Square));
+    ASSERT_THAT(stats[0].clones, Eq(2u));
+    ASSERT_THAT(stats[0].bytes, Eq(2 * sizeof(Square)));
+    ASSERT_THAT(std::accumulate(stats[0].latency.begin(), stats[0].latency.end(), std::size_t{0}), Eq(2u));
+}
+
+TEST(FigureTests_v5, instrumentation_counts_clones_with_memory_resource)
+{
+    object::instrumentation::reset();
+    std::pmr::monotonic_buffer_resource arena;
+    auto figure = object::clone(FinalSquare{}, arena);
+
+    auto stats = object::instrumentation::snapshot();
+
+    ASSERT_THAT(stats.size(), Eq(1u));
+    ASSERT_TRUE(stats[0].type == typeid(FinalSquare));
+    ASSERT_THAT(stats[0].clones, Eq(1u));
+}
+#endif
+
+#if defined(OBJECT_CLONE_SAMPLING)
+TEST(FigureTests_v5, sampling_records_every_period_th_clone)
+{
+    object::sampling::set_period(10);
+    object::sampling::reset();
+    auto square = Square{};
+    for (auto i = 0; i < 25; ++i)
+        object::clone(square);
+
+    auto samples = object::sampling::snapshot();
+
+    ASSERT_THAT(samples.size(), Eq(3u));    // clones 0, 10 and 20
+    ASSERT_TRUE(*samples[0].type == typeid(Square));
+    ASSERT_THAT(samples[0].bytes, Eq(sizeof(Square)));
+    ASSERT_THAT(samples[0].tag, IsNull());
+    object::sampling::set_period(1024);
+}
+
+TEST(FigureTests_v5, sampling_scope_tags_samples_and_trace_names_them)
+{
+    object::sampling::set_period(1);
+    object::sampling::reset();
+    auto square = Square{};
+    {
+        object::sampling::scope scope{"loader"};
+        object::clone(square);
+    }
+    std::ostringstream trace;
+    object::sampling::write_trace(trace);
+
+    ASSERT_THAT(object::sampling::snapshot().size(), Eq(1u));
+    ASSERT_THAT(object::sampling::snapshot()[0].tag, StrEq("loader"));
+    ASSERT_THAT(trace.str(), StartsWith("{\"traceEvents\":[{"));
+    ASSERT_THAT(trace.str(), HasSubstr("\"tag\":\"loader\""));
+    object::sampling::set_period(1024);
+}
+
+TEST(FigureTests_v5, sampling_gives_threads_small_sequential_ids)
+{
+    object::sampling::set_period(1);
+    object::sampling::reset();
+    auto square = Square{};
+    object::clone(square);
+    std::thread([&] { object::clone(square); }).join();
+
+    auto samples = object::sampling::snapshot();
+
+    ASSERT_THAT(samples.size(), Eq(2u));
+    ASSERT_THAT(samples[0].thread, Ne(samples[1].thread));
+    ASSERT_THAT(samples[0].thread, Lt(1000u));
+    ASSERT_THAT(samples[1].thread, Lt(1000u));
+    object::sampling::set_period(1024);
+}
+
+TEST(FigureTests_v5, sampling_site_scope_tags_samples_with_file_and_line)
+{
+    object::sampling::set_period(1);
+    object::sampling::reset();
+    auto square = Square{};
+    {
+        OBJECT_CLONE_SAMPLING_SCOPE();
+        object::clone(square);
+    }
+
+    ASSERT_THAT(object::sampling::snapshot().size(), Eq(1u));
+    ASSERT_THAT(object::sampling::snapshot()[0].tag, HasSubstr("FigureTests-v5.cpp:"));
+    object::sampling::set_period(1024);
+}
+#endif
+
+TEST(FigureTests_v5, cow_ptr_of_Square_yields_Square)
+{
+    auto square = object::cow_ptr<Square>{std::make_shared<Square>()};
+    const auto& shared = square;
+
+    ASSERT_TRUE((std::is_same<Square&, decltype(*square)>::value));
+    ASSERT_TRUE((std::is_same<const Square&, decltype(*shared)>::value));
+}
+
+TEST(FigureTests_v5, cow_ptr_copies_share_object_on_const_access)
+{
+    auto figure = object::cow_ptr<Figure>{object::clone(Square{2.})};
+    const auto copy = figure;
+
+    ASSERT_THAT(copy->area(), Eq(4.));
+    ASSERT_THAT(copy.get(), Eq(static_cast<const object::cow_ptr<Figure>&>(figure).get()));
+    ASSERT_FALSE(copy.unique());
+}
+
+TEST(FigureTests_v5, cow_ptr_detaches_clone_on_first_non_const_access)
+{
+    auto source = std::make_shared<Square>(2.);
+    auto square = object::cow_ptr<Square>{source};
+
+    square->a = 3.;
+
+    ASSERT_TRUE(square.unique());
+    ASSERT_THAT(source->area(), Eq(4.));
+    ASSERT_THAT(square->area(), Eq(9.));
+}
+
+TEST(FigureTests_v5, snapshot_is_restored_to_figures_of_same_type_and_area)
+{
+    auto figures = make_squares(5);
+    auto buffer  = object::snapshot(figures.begin(), figures.end());
+    auto copies  = object::restore<Figure>(buffer);
+
+    ASSERT_TRUE((std::is_same<std::vector<std::unique_ptr<Figure>>, decltype(copies)>::value));
+    ASSERT_THAT(copies.size(), Eq(figures.size()));
+    for (auto i = 0u; i < figures.size(); ++i)
+    {
+        ASSERT_TRUE(typeid(*copies[i]) == typeid(Square));
+        ASSERT_THAT(copies[i]->area(), Eq(figures[i]->area()));
+    }
+}
+
+TEST(FigureTests_v5, snapshot_is_one_flat_buffer_of_payloads)
+{
+    auto figures = make_squares(3);
+    auto buffer  = object::snapshot(figures.begin(), figures.end());
+
+    ASSERT_THAT(buffer.size(), Eq(sizeof(object::snapshot_header) + 3 * (sizeof(object::snapshot_record) + sizeof(double))));
+}
+
+TEST(FigureTests_v5, snapshot_of_unregistered_type_throws)
+{
+    std::vector<std::unique_ptr<Figure>> figures;
+    figures.emplace_back(new Polygon{});
+
+    ASSERT_THROW(object::snapshot(figures.begin(), figures.end()), std::invalid_argument);
+}
+
+TEST(FigureTests_v5, restore_of_truncated_snapshot_throws)
+{
+    auto figures = make_squares(2);
+    auto buffer  = object::snapshot(figures.begin(), figures.end());
+    buffer.pop_back();
+
+    ASSERT_THROW(object::restore<Figure>(buffer), std::invalid_argument);
+}
+
+TEST(FigureTests_v5, figure_view_of_snapshot_has_same_areas_as_figures)
+{
+    auto figures = make_squares(5);
+    auto buffer  = object::snapshot(figures.begin(), figures.end());
+    auto view    = FigureView{buffer};
+
+    ASSERT_THAT(view.size(), Eq(figures.size()));
+    auto i = 0u;
+    for (auto figure : view)
+        ASSERT_THAT(figure.area(), Eq(figures[i++]->area()));
+    ASSERT_THAT(i, Eq(figures.size()));
+    ASSERT_THAT(view.total_area(), Eq(0. + 1 + 4 + 9 + 16));
+}
+
+TEST(FigureTests_v5, figure_view_iterator_is_input_iterator_yielding_figures_by_value)
+{
+    using traits = std::iterator_traits<FigureView::iterator>;
+
+    ASSERT_TRUE((std::is_same<std::input_iterator_tag, traits::iterator_category>::value));
+    ASSERT_TRUE((std::is_same<FigureView::figure, decltype(*std::declval<FigureView::iterator>())>::value));
+}
+
+TEST(FigureTests_v5, figure_view_of_malformed_buffer_throws)
+{
+    auto buffer = std::vector<unsigned char>(sizeof(object::snapshot_header));
+
+    ASSERT_THROW(FigureView{buffer}, std::invalid_argument);
+}
+
+#if defined(__unix__)
+TEST(FigureTests_v5, figure_view_works_over_memory_mapped_snapshot)
+{
+    auto figures = make_squares(4);
+    auto buffer  = object::snapshot(figures.begin(), figures.end());
+
+    auto file = std::tmpfile();
+    ASSERT_THAT(std::fwrite(buffer.data(), 1, buffer.size(), file), Eq(buffer.size()));
+    std::fflush(file);
+    auto mapping = ::mmap(nullptr, buffer.size(), PROT_READ, MAP_PRIVATE, ::fileno(file), 0);
+    ASSERT_THAT(mapping, Ne(MAP_FAILED));
+
+    auto view = FigureView{mapping, buffer.size()};
+    ASSERT_THAT(view.total_area(), Eq(0. + 1 + 4 + 9));
+
+    ::munmap(mapping, buffer.size());
+    std::fclose(file);
+}
+#endif
+
+TEST(FigureTests_v5, lazy_clone_dropped_before_use_never_clones)
+{
+    auto polygon = Polygon{{{0, 0}, {2, 0}, {2, 2}, {0, 2}}};
+    {
+        auto copy = object::lazy_clone<Polygon>{polygon};
+
+        ASSERT_FALSE(copy.materialized());
+    }
+    polygon.move_vertex(0, {1, 1});
+}
+
+TEST(FigureTests_v5, lazy_clone_is_made_on_first_dereference)
+{
+    auto polygon = Polygon{{{0, 0}, {2, 0}, {2, 2}, {0, 2}}};
+    auto copy = object::lazy_clone<Polygon>{polygon};
+
+    ASSERT_TRUE((std::is_same<Polygon&, decltype(*copy)>::value));
+    ASSERT_THAT(copy->area(), Eq(4.));
+    ASSERT_TRUE(copy.materialized());
+    ASSERT_THAT(copy.get(), Ne(&polygon));
+}
+
+TEST(FigureTests_v5, lazy_clone_is_made_before_source_changes)
+{
+    auto polygon = Polygon{{{0, 0}, {2, 0}, {2, 2}, {0, 2}}};
+    auto copy = object::lazy_clone<Figure>{polygon};
+
+    polygon.move_vertex(2, {4, 4});
+
+    ASSERT_TRUE(copy.materialized());
+    ASSERT_THAT(copy.version(), Lt(polygon.version()));
+    ASSERT_THAT(copy->area(), Eq(4.));
+    ASSERT_THAT(polygon.area(), Eq(8.));
+}
+
+TEST(FigureTests_v5, lazy_clone_is_made_before_source_is_destroyed)
+{
+    auto polygon = std::unique_ptr<Polygon>(new Polygon{{{0, 0}, {3, 0}, {0, 3}}});
+    auto copy = object::lazy_clone<Polygon>{*polygon};
+
+    polygon.reset();
+
+    ASSERT_TRUE(copy.materialized());
+    ASSERT_THAT(copy->area(), Eq(4.5));
+}
+
+TEST(FigureTests_v5, lazy_clone_of_not_versioned_source_throws)
+{
+    auto square = Square{};
+
+    ASSERT_THROW(object::lazy_clone<Figure>{square}, std::invalid_argument);
+}
+
+TEST(FigureTests_v5, cached_area_is_computed_once)
+{
+    auto polygon = Polygon{{{0, 0}, {2, 0}, {2, 2}, {0, 2}}};
+    Polygon::area_computations = 0;
+
+    ASSERT_THAT(polygon.area(), Eq(4.));
+    ASSERT_THAT(polygon.area(), Eq(4.));
+    ASSERT_THAT(Polygon::area_computations, Eq(1));
+}
+
+TEST(FigureTests_v5, cached_area_is_carried_to_clone)
+{
+    auto polygon = Polygon{{{0, 0}, {2, 0}, {2, 2}, {0, 2}}};
+    polygon.area();
+    Polygon::area_computations = 0;
+
+    auto figure = object::clone(static_cast<Figure*>(&polygon));
+
+    ASSERT_THAT(figure->area(), Eq(4.));
+    ASSERT_THAT(Polygon::area_computations, Eq(0));
+}
+
+TEST(FigureTests_v5, cached_area_is_invalidated_by_mutation)
+{
+    auto polygon = Polygon{{{0, 0}, {2, 0}, {2, 2}, {0, 2}}};
+    polygon.area();
+    Polygon::area_computations = 0;
+
+    polygon.move_vertex(2, {4, 4});
+
+    ASSERT_THAT(polygon.area(), Eq(8.));
+    ASSERT_THAT(Polygon::area_computations, Eq(1));
+}
+
+TEST(FigureTests_v5, shared_square_clone_shared_return_pointer_of_type_SharedSquare)
+{
+    auto square = SharedSquare{};
+    auto figure = object::clone_shared(square);
+
+    ASSERT_TRUE((std::is_same<object::intrusive_ptr<SharedSquare>, decltype(figure)>::value));
+    ASSERT_THAT(figure.use_count(), Eq(1));
+}
+
+TEST(FigureTests_v5, shared_square_clone_shared_via_base_class_return_pointer_of_type_SharedFigure)
+{
+    auto a = 3.;
+    auto square = SharedSquare{a};
+    auto figure = object::clone_shared(static_cast<SharedFigure*>(&square));
+
+    ASSERT_TRUE((std::is_same<object::intrusive_ptr<SharedFigure>, decltype(figure)>::value));
+    ASSERT_THAT(figure->area(), Eq(a*a));
+}
+
+TEST(FigureTests_v5, clone_shared_object_is_deleted_with_last_reference)
+{
+    auto square = SharedSquare{};
+    auto alive  = SharedSquare::alive;
+    {
+        object::intrusive_ptr<SharedFigure> figure = object::clone_shared(square);
+        auto copy = figure;
+
+        ASSERT_THAT(copy.use_count(), Eq(2));
+        ASSERT_THAT(SharedSquare::alive, Eq(alive + 1));
+    }
+    ASSERT_THAT(SharedSquare::alive, Eq(alive));
+}
+
+TEST(FigureTests_v5, clone_shared_object_can_be_shared_between_threads)
+{
+    auto figure = object::clone_shared(SharedSquare{2.});
+
+    std::vector<std::thread> threads;
+    for (auto i = 0; i < 4; ++i)
+        threads.emplace_back([figure]
+        {
+            for (auto j = 0; j < 1000; ++j)
+            {
+                auto copy = figure;
+                ASSERT_THAT(copy->area(), Eq(4.));
+            }
+        });
+    for (auto& thread : threads)
+        thread.join();
+
+    ASSERT_THAT(figure.use_count(), Eq(1));
+}
+
+TEST(FigureTests_v5, size_of_clone_is_size_of_dynamic_type)
+{
+    auto polygon = Polygon{};
+    const Figure& figure = polygon;
+
+    ASSERT_THAT(object::size_of(figure), Eq(sizeof(Polygon)));
+    ASSERT_THAT(object::align_of(figure), Eq(alignof(Polygon)));
+}
+
+TEST(FigureTests_v5, square_cloned_into_storage_lives_in_storage)
+{
+    alignas(std::max_align_t) unsigned char storage[64];
+    auto a = 3.;
+    auto square = Square{a};
+    auto figure = object::clone_into(static_cast<Figure*>(&square), storage, sizeof(storage));
+
+    ASSERT_TRUE((std::is_same<object::placed_ptr<Figure>, decltype(figure)>::value));
+    ASSERT_THAT(static_cast<void*>(figure.get()), Eq(static_cast<void*>(storage)));
+    ASSERT_THAT(figure->area(), Eq(a*a));
+}
+
+TEST(FigureTests_v5, clone_into_too_small_storage_throws)
+{
+    alignas(std::max_align_t) unsigned char storage[sizeof(Square) - 1];
+    auto square = Square{};
+
+    ASSERT_THROW(object::clone_into(square, storage, sizeof(storage)), std::length_error);
+}
+
+TEST(FigureTests_v5, placed_clone_is_destroyed_with_pointer)
+{
+    alignas(std::max_align_t) unsigned char storage[sizeof(SharedSquare)];
+    auto square = SharedSquare{};
+    auto alive  = SharedSquare::alive;
+    {
+        auto figure = object::clone_into(square, storage, sizeof(storage));
+
+        ASSERT_THAT(SharedSquare::alive, Eq(alive + 1));
+    }
+    ASSERT_THAT(SharedSquare::alive, Eq(alive));
+}
+
+TEST(FigureTests_v5, copy_of_inplace_clone_is_cloned_into_own_storage)
+{
+    auto a = 2.;
+    auto square = object::inplace<Figure, 32>{Square{a}};
+    auto figure = square;
+
+    ASSERT_THAT(static_cast<void*>(figure.get()), Ne(static_cast<void*>(square.get())));
+    ASSERT_THAT(figure->area(), Eq(a*a));
+}
+
+TEST(FigureTests_v5, figure_collection_reader_keeps_seeing_its_version)
+{
+    FigureCollection figures;
+    figures.add(Square{1.});
+    figures.add(Square{2.});
+
+    auto before = figures.read();
+    figures.update(0, [](Figure& figure) { static_cast<Square&>(figure).a = 3.; });
+    auto after = figures.read();
+
+    ASSERT_THAT((*before)[0]->area(), Eq(1.));
+    ASSERT_THAT((*after)[0]->area(), Eq(9.));
+}
+
+TEST(FigureTests_v5, figure_collection_update_clones_only_changed_figure)
+{
+    FigureCollection figures;
+    figures.add(Square{1.});
+    figures.add(Square{2.});
+
+    auto before = figures.read();
+    figures.update(0, [](Figure& figure) { static_cast<Square&>(figure).a = 3.; });
+    auto after = figures.read();
+
+    ASSERT_THAT((*after)[0].get(), Ne((*before)[0].get()));
+    ASSERT_THAT((*after)[1].get(), Eq((*before)[1].get()));
+}
+
+TEST(FigureTests_v5, figure_collection_frees_replaced_version_after_its_readers)
+{
+    FigureCollection figures;
+    figures.add(Square{1.});
+
+    std::weak_ptr<const Figure> replaced;
+    {
+        auto reader = figures.read();
+        replaced = (*reader)[0];
+        figures.update(0, [](Figure&) {});
+
+        ASSERT_FALSE(replaced.expired());
+    }
+    figures.add(Square{2.});
+
+    ASSERT_TRUE(replaced.expired());
+}
+
+TEST(FigureTests_v5, figure_collection_can_be_read_while_written)
+{
+    FigureCollection figures;
+    for (auto i = 0; i < 100; ++i)
+        figures.add(Square{1.});
+
+    std::atomic<bool> done{false};
+    std::vector<std::thread> readers;
+    for (auto i = 0; i < 3; ++i)
+        readers.emplace_back([&]
+        {
+            while (!done)
+                for (auto& figure : figures.read())
+                    ASSERT_TRUE(figure->area() == 1. || figure->area() == 4.);
+        });
+
+    for (auto i = 0u; i < 100; ++i)
+        figures.update(i, [](Figure& figure) { static_cast<Square&>(figure).a = 2.; });
+    done = true;
+    for (auto& reader : readers)
+        reader.join();
+
+    for (auto& figure : figures.read())
+        ASSERT_THAT(figure->area(), Eq(4.));
+}
+
+TEST(FigureTests_v5, colored_square_clone_method_called_directly_return_pointer_of_type_ColoredSquare)
+{
+    auto square = ColoredSquare{2., 7};
+    auto figure = object::clone(square);
+
+    ASSERT_TRUE((std::is_same<std::unique_ptr<ColoredSquare>, decltype(figure)>::value));
+    ASSERT_THAT(figure->color, Eq(7));
+}
+
+TEST(FigureTests_v5, colored_square_gets_every_clone_hook_from_cloneable_impl)
+{
+    auto square = ColoredSquare{2., 7};
+    const Figure& figure = square;
+    std::pmr::monotonic_buffer_resource arena;
+    alignas(std::max_align_t) unsigned char storage[sizeof(ColoredSquare)];
+
+    auto copy      = object::clone(figure);
+    auto moved     = object::clone(ColoredSquare{2., 7});
+    auto allocated = object::clone(figure, arena);
+    auto placed    = object::clone_into(figure, storage, sizeof(storage));
+
+    ASSERT_THAT(object::size_of(figure), Eq(sizeof(ColoredSquare)));
+    for (auto clone : {copy.get(), static_cast<Figure*>(moved.get()), allocated.get(), placed.get()})
+    {
+        ASSERT_TRUE(typeid(*clone) == typeid(ColoredSquare));
+        ASSERT_THAT(clone->area(), Eq(4.));
+    }
+}
+
+TEST(FigureTests_v5, deep_clone_copies_whole_graph)
+{
+    auto first  = Square{1.};
+    auto second = Square{2.};
+    auto group  = Group{&first, &second};
+    object::clone_context context;
+
+    auto copy = object::deep_clone(group, context);
+
+    ASSERT_TRUE((std::is_same<Group*, decltype(copy)>::value));
+    ASSERT_THAT(copy->area(), Eq(5.));
+    ASSERT_THAT(copy->children[0], Ne(&first));
+    ASSERT_THAT(copy->children[1], Ne(&second));
+    ASSERT_THAT(context.size(), Eq(3u));
+}
+
+TEST(FigureTests_v5, deep_clone_copies_shared_node_once)
+{
+    auto shared = Square{2.};
+    auto left   = Group{&shared};
+    auto right  = Group{&shared};
+    auto root   = Group{&left, &right};
+    object::clone_context context;
+
+    auto copy = object::deep_clone(root, context);
+
+    auto copy_left  = static_cast<const Group*>(copy->children[0]);
+    auto copy_right = static_cast<const Group*>(copy->children[1]);
+    ASSERT_THAT(copy_left->children[0], Eq(copy_right->children[0]));
+    ASSERT_THAT(copy_left->children[0], Ne(&shared));
+    ASSERT_THAT(context.size(), Eq(4u));
+}
+
+TEST(FigureTests_v5, deep_clone_preserves_cycle)
+{
+    auto first  = Group{};
+    auto second = Group{&first};
+    first.children.push_back(&second);
+    object::clone_context context;
+
+    auto copy = object::deep_clone(&first, context);
+
+    auto copy_second = static_cast<const Group*>(copy->children[0]);
+    ASSERT_THAT(copy_second, Ne(&second));
+    ASSERT_THAT(copy_second->children[0], Eq(copy));
+    ASSERT_THAT(context.size(), Eq(2u));
+}
+
+TEST(FigureTests_v5, deep_clone_allocates_graph_from_one_arena)
+{
+    auto squares = std::vector<Square>(100, Square{1.});
+    auto group   = Group{};
+    for (auto& square : squares)
+        group.children.push_back(&square);
+    counting_resource resource;
+    {
+        object::clone_context context{resource};
+
+        ASSERT_THAT(object::deep_clone(group, context)->area(), Eq(100.));
+        ASSERT_THAT(resource.allocations, Lt(10));
+    }
+    ASSERT_THAT(resource.deallocations, Eq(resource.allocations));
+}
+
+TEST(FigureTests_v5, closed_figure_clone_return_closed_figure_by_value)
+{
+    using figure_type = closed_figure<Square, Rectangle>;
+    auto figure = figure_type{Rectangle{2., 3.}};
+
+    auto copy = object::clone(figure);
+
+    ASSERT_TRUE((std::is_same<figure_type, decltype(copy)>::value));
+    ASSERT_TRUE(copy.holds<Rectangle>());
+    ASSERT_THAT(copy.area(), Eq(6.));
+}
+
+TEST(FigureTests_v5, closed_figure_clone_by_pointer_and_rvalue)
+{
+    using figure_type = closed_figure<Square, Rectangle>;
+    const figure_type figure = Square{2.};
+
+    auto copy  = object::clone(&figure);
+    auto moved = object::clone(figure_type{Square{3.}});
+
+    ASSERT_TRUE((std::is_same<figure_type, decltype(copy)>::value));
+    ASSERT_TRUE((std::is_same<figure_type, decltype(moved)>::value));
+    ASSERT_THAT(copy.area(), Eq(4.));
+    ASSERT_THAT(moved.area(), Eq(9.));
+}
+
+TEST(FigureTests_v5, closed_figure_without_vtable_clones_through_mutable_pointer_and_clone_all)
+{
+    using figure_type = closed_figure<Rectangle>;
+    auto first  = figure_type{Rectangle{1., 2.}};
+    auto second = figure_type{Rectangle{3., 4.}};
+    std::vector<figure_type*> figures{&first, &second};
+    std::vector<figure_type>  copies;
+
+    auto copy = object::clone(&first);
+    object::clone_all(figures.begin(), figures.end(), std::back_inserter(copies));
+
+    ASSERT_TRUE((std::is_same<figure_type, decltype(copy)>::value));
+    ASSERT_THAT(copy.area(), Eq(2.));
+    ASSERT_THAT(copies.size(), Eq(2u));
+    ASSERT_THAT(copies[1].area(), Eq(12.));
+}
+
+TEST(FigureTests_v5, closed_figure_of_plain_types_has_no_vtable)
+{
+    ASSERT_FALSE((std::is_polymorphic<closed_figure<Rectangle>>::value));
+    ASSERT_TRUE((std::is_trivially_copyable<closed_figure<Rectangle>>::value));
+}
+
+TEST(FigureTests_v5, compact_handle_packs_tag_in_high_bits)
+{
+    auto handle = object::compact_handle{3, 42};
+
+    ASSERT_THAT(sizeof(handle), Eq(4u));
+    ASSERT_THAT(handle.tag(), Eq(3u));
+    ASSERT_THAT(handle.index(), Eq(42u));
+}
+
+TEST(FigureTests_v5, clone_into_compact_slabs_return_compact_handle)
+{
+    auto square = Square{3.};
+    object::compact_slabs<Figure> slabs;
+
+    auto first  = object::clone(square, slabs);
+    auto second = object::clone(static_cast<const Figure*>(&square), slabs);
+
+    ASSERT_TRUE((std::is_same<object::compact_handle, decltype(first)>::value));
+    ASSERT_THAT(first.tag(), Eq(second.tag()));
+    ASSERT_THAT(second.index(), Eq(first.index() + 1));
+    ASSERT_THAT(slabs.restore(second)->area(), Eq(9.));
+}
+
+TEST(FigureTests_v5, compact_figures_dispatch_area_on_tag)
+{
+    CompactFigures figures;
+    for (auto& square : make_squares(10))
+        figures.add(*square);
+
+    ASSERT_THAT(figures.size(), Eq(10u));
+    ASSERT_THAT(figures.total_area(), Eq(285.));   // 0 + 1 + 4 + ... + 81
+}
+
+TEST(FigureTests_v5, compact_slabs_reject_unregistered_type)
+{
+    object::compact_slabs<Figure> slabs;
+
+    ASSERT_THROW(object::clone(ColoredSquare{1., 2}, slabs), std::invalid_argument);
+}
+
+TEST(FigureTests_v5, for_each_sorted_visits_each_dynamic_type_once)
+{
+    std::vector<std::unique_ptr<Figure>> figures;
+    figures.emplace_back(new Square(1.));
+    figures.emplace_back(new ColoredSquare(2., 1));
+    figures.emplace_back(new Square(3.));
+    auto visits = 0;
+
+    object::for_each_sorted(figures.begin(), figures.end(), [&](const std::type_info& type, const Figure* const* objects, const std::size_t* positions, std::size_t count)
+    {
+        ++visits;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            ASSERT_TRUE(typeid(*objects[i]) == type);
+            ASSERT_THAT(objects[i], Eq(figures[positions[i]].get()));
+        }
+    });
+
+    ASSERT_THAT(visits, Eq(2));
+}
+
+TEST(FigureTests_v5, areas_of_mixed_figures_keep_range_order)
+{
+    std::vector<std::unique_ptr<Figure>> figures;
+    for (auto i = 0; i < 30; ++i)
+        switch (i % 3)
+        {
+            case 0:  figures.emplace_back(new Square(i)); break;
+            case 1:  figures.emplace_back(new Polygon({{0, 0}, {double(i), 0}, {0, 1}})); break;
+            default: figures.emplace_back(new ColoredSquare(i, i)); break;
+        }
+    std::vector<double> result;
+
+    areas(figures.begin(), figures.end(), std::back_inserter(result));
+
+    ASSERT_THAT(result.size(), Eq(figures.size()));
+    for (std::size_t i = 0; i < figures.size(); ++i)
+        ASSERT_THAT(result[i], Eq(figures[i]->area()));
+}
+
+TEST(FigureTests_v5, clone_into_generation_arena_return_arena_ptr_of_static_type)
+{
+    auto square = Square{2.};
+    object::generation_arena arena;
+
+    auto copy   = object::clone(square, arena);
+    auto figure = object::clone(static_cast<const Figure*>(&square), arena);
+
+    ASSERT_TRUE((std::is_same<object::arena_ptr<Square>, decltype(copy)>::value));
+    ASSERT_TRUE((std::is_same<object::arena_ptr<Figure>, decltype(figure)>::value));
+    ASSERT_TRUE(typeid(*figure) == typeid(Square));
+    ASSERT_THAT(copy->area(), Eq(4.));
+}
+
+TEST(FigureTests_v5, generation_arena_reset_destroys_clones_and_reuses_blocks)
+{
+    auto square = SharedSquare{1.};
+    object::generation_arena arena{1024};
+    auto alive = SharedSquare::alive;
+
+    for (auto i = 0; i < 100; ++i)
+        object::clone(square, arena);
+    auto capacity = arena.capacity();
+    ASSERT_THAT(SharedSquare::alive, Eq(alive + 100));
+
+    arena.reset();
+    ASSERT_THAT(SharedSquare::alive, Eq(alive));
+    for (auto i = 0; i < 100; ++i)
+        object::clone(square, arena);
+    ASSERT_THAT(arena.capacity(), Eq(capacity));
+}
+
+#if defined(NDEBUG)
+TEST(FigureTests_v5, arena_ptr_is_plain_pointer_in_release_build)
+{
+    ASSERT_THAT(sizeof(object::arena_ptr<FinalSquare>), Eq(sizeof(FinalSquare*)));
+    ASSERT_TRUE(std::is_trivially_copyable<object::arena_ptr<FinalSquare>>::value);
+}
+#else
+TEST(FigureTests_v5, arena_ptr_from_previous_generation_is_stale)
+{
+    object::generation_arena arena;
+    auto copy = object::clone(FinalSquare{3.}, arena);
+    ASSERT_TRUE(copy.valid());
+
+    arena.reset();
+
+    ASSERT_FALSE(copy.valid());
+    ASSERT_THROW(copy->area(), std::logic_error);
+}
+
+TEST(FigureTests_v5, arena_ptr_outliving_its_arena_is_stale)
+{
+    auto copy = object::arena_ptr<FinalSquare>{};
+    {
+        object::generation_arena arena;
+        copy = object::clone(FinalSquare{3.}, arena);
+        ASSERT_TRUE(copy.valid());
+    }
+
+    ASSERT_FALSE(copy.valid());
+    ASSERT_THROW(copy->area(), std::logic_error);
+}
+#endif
+
+TEST(FigureTests_v5, numa_current_node_is_one_of_machine_nodes)
+{
+    ASSERT_THAT(object::numa::node_count(), Ge(1));
+    ASSERT_THAT(object::numa::current_node(), Ge(0));
+    ASSERT_THAT(object::numa::current_node(), Lt(object::numa::node_count()));
+}
+
+TEST(FigureTests_v5, numa_placed_clone_keeps_static_type)
+{
+    auto square = Square{2.};
+    auto figure = static_cast<const Figure*>(&square);
+
+    auto copy   = object::clone(square, object::numa_placement::local_to_caller());
+    auto source = object::clone(figure, object::numa_placement::local_to_source());
+    auto node   = object::clone(square, object::numa_placement::on_node(0));
+
+    ASSERT_TRUE((std::is_same<object::resource_ptr<Square>, decltype(copy)>::value));
+    ASSERT_TRUE((std::is_same<object::resource_ptr<Figure>, decltype(source)>::value));
+    ASSERT_TRUE(typeid(*source) == typeid(Square));
+    ASSERT_THAT(node->area(), Eq(4.));
+    ASSERT_THAT(object::numa::node_of(node.get()), AnyOf(Eq(-1), Eq(0)));
+}
+
+TEST(FigureTests_v5, numa_placement_on_missing_node_throws)
+{
+    ASSERT_THROW(object::clone(Square{}, object::numa_placement::on_node(object::numa::node_count())), std::invalid_argument);
+}
+
+#if defined(__linux__)
+TEST(FigureTests_v5, numa_node_resource_rejects_alignment_above_page_size)
+{
+    object::numa::node_resource pages{0};
+    auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+
+    auto storage = pages.allocate(page, page);
+    ASSERT_THAT(reinterpret_cast<std::uintptr_t>(storage) % page, Eq(0u));
+    pages.deallocate(storage, page, page);
+    ASSERT_THROW(static_cast<void>(pages.allocate(page, 2 * page)), std::bad_alloc);
+}
+#endif
+
+TEST(FigureTests_v5, figure_collection_read_waits_while_all_reader_slots_stay_taken)
+{
+    FigureCollection collection;
+    collection.add(Square(2.));
+    std::vector<FigureCollection::reader> readers;
+    for (auto i = 0u; i < FigureCollection::max_readers; ++i)
+        readers.push_back(collection.read());
+
+    auto waiting = std::async(std::launch::async, [&] { return collection.read()->size(); });
+    ASSERT_THAT(waiting.wait_for(std::chrono::milliseconds(50)), Eq(std::future_status::timeout));
+    readers.pop_back();
+
+    ASSERT_THAT(waiting.get(), Eq(1u));
+}
+
+TEST(FigureTests_v5, figure_collection_serves_more_threads_than_reader_slots)
+{
+    FigureCollection collection;
+    collection.add(Square(2.));
+    std::atomic<int> reads{0};
+
+    std::vector<std::thread> threads;
+    for (auto i = 0u; i < FigureCollection::max_readers + 16; ++i)
+        threads.emplace_back([&]
+        {
+            for (auto j = 0; j < 10; ++j)
+            {
+                auto figures = collection.read();
+                if ((*figures)[0]->area() == 4.)
+                    ++reads;
+            }
+        });
+    for (auto& thread : threads)
+        thread.join();
+
+    ASSERT_THAT(reads.load(), Eq(int(FigureCollection::max_readers + 16) * 10));
+}
+
+TEST(FigureTests_v5, figure_collection_rebalance_keeps_figures)
+{
+    FigureCollection collection;
+    for (auto a = 1; a <= 3; ++a)
+        collection.add(Square(a));
+    collection.read();
+
+    auto moved = collection.rebalance();
+
+    auto figures = collection.read();
+    ASSERT_THAT(moved, Le(3u));
+    ASSERT_THAT(figures->size(), Eq(3u));
+    ASSERT_THAT((*figures)[2]->area(), Eq(9.));
+}
+
+TEST(FigureTests_v5, figure_collection_rebalance_without_reads_moves_nothing)
+{
+    FigureCollection collection;
+    for (auto a = 1; a <= 3; ++a)
+        collection.add(Square(a));
+
+    ASSERT_THAT(collection.rebalance(), Eq(0u));
+    ASSERT_THAT(collection.read()->size(), Eq(3u));
+}
+
+TEST(FigureTests_v5, figure_collection_rebalance_moves_figures_to_node_of_readers)
+{
+    FigureCollection collection;
+    for (auto a = 1; a <= 3; ++a)
+        collection.add(Square(a));
+    for (auto i = 0; i < 10; ++i)
+        collection.read();
+
+    collection.rebalance();
+
+    auto figures = collection.read();
+    for (auto& figure : *figures)
+        ASSERT_THAT(object::numa::node_of(figure.get()), AnyOf(Eq(-1), Eq(object::numa::current_node())));
+}
+
+TEST(FigureTests_v5, versioned_objects_get_unique_versions)
+{
+    auto first  = Polygon{{{0, 0}, {1, 0}, {0, 1}}};
+    auto second = Polygon{{{0, 0}, {1, 0}, {0, 1}}};
+    auto copy   = first;
+
+    ASSERT_THAT(first.version(), Ne(second.version()));
+    ASSERT_THAT(copy.version(), Eq(first.version()));
+}
+
+TEST(FigureTests_v5, clone_incremental_clones_only_changed_figures)
+{
+    std::vector<std::unique_ptr<Figure>> scene;
+    for (auto i = 1; i <= 10; ++i)
+        scene.emplace_back(new Polygon({{0, 0}, {double(i), 0}, {0, 1}}));
+    auto first = object::clone_incremental(object::incremental_snapshot<Figure>{}, scene);
+
+    static_cast<Polygon&>(*scene[3]).move_vertex(1, {8, 0});
+    auto second = object::clone_incremental(first, scene);
+
+    ASSERT_TRUE((std::is_same<object::incremental_snapshot<Figure>, decltype(second)>::value));
+    ASSERT_THAT(first.cloned(), Eq(10u));
+    ASSERT_THAT(second.cloned(), Eq(1u));
+    ASSERT_THAT(second.share(0), Eq(first.share(0)));
+    ASSERT_THAT(second.share(3), Ne(first.share(3)));
+    ASSERT_THAT(first[3].area(), Eq(2.));
+    ASSERT_THAT(second[3].area(), Eq(4.));
+}
+
+TEST(FigureTests_v5, clone_incremental_follows_moved_figures_and_reclones_unversioned_ones)
+{
+    std::vector<std::unique_ptr<Figure>> scene;
+    scene.emplace_back(new Square(1.));
+    scene.emplace_back(new Polygon({{0, 0}, {1, 0}, {0, 1}}));
+    auto first = object::clone_incremental(object::incremental_snapshot<Figure>{}, scene);
+
+    std::swap(scene[0], scene[1]);
+    auto second = object::clone_incremental(first, scene);
+
+    ASSERT_THAT(second.cloned(), Eq(1u));     // Square is not versioned
+    ASSERT_THAT(second.share(0), Eq(first.share(1)));
+    ASSERT_THAT(second[1].area(), Eq(1.));
+}
+
+struct FigureHeapTests_v5 : HeapTracking {};
+
+// first clone of a type may fill instrumentation tables - measured clones come after it
+TEST_F(FigureHeapTests_v5, clone_makes_one_allocation)
+{
+    auto square = Square{};
+    const Figure& figure = square;
+    object::clone(figure);
+
+    auto copies = allocations_of([&]
+    {
+        auto copy = object::clone(figure);
+    });
+
+    ASSERT_THAT(copies, Eq(1u));
+}
+
+TEST_F(FigureHeapTests_v5, clone_with_arena_makes_no_allocation)
+{
+    auto square = Square{};
+    const Figure& figure = square;
+    alignas(std::max_align_t) unsigned char buffer[1024];
+    std::pmr::monotonic_buffer_resource arena{buffer, sizeof(buffer), std::pmr::null_memory_resource()};
+    object::clone(figure, arena);
+
+    auto copies = allocations_of([&]
+    {
+        auto copy = object::clone(figure, arena);
+    });
+
+    ASSERT_THAT(copies, Eq(0u));
+}
+
+TEST_F(FigureHeapTests_v5, clone_all_of_alternating_types_into_monotonic_buffer_makes_no_allocation)
+{
+    std::vector<std::unique_ptr<Figure>> figures;
+    for (auto i = 0; i < 100; ++i)
+        figures.emplace_back(i % 2 ? static_cast<Figure*>(new Square(i)) : new FinalSquare(i));
+    std::vector<object::resource_ptr<Figure>> copies(figures.size());
+    alignas(std::max_align_t) unsigned char buffer[4096];
+    std::pmr::monotonic_buffer_resource arena{buffer, sizeof(buffer), std::pmr::null_memory_resource()};
+
+    auto clones = allocations_of([&]
+    {
+        object::clone_all(figures.begin(), figures.end(), copies.begin(), arena);
+    });
+
+    ASSERT_THAT(clones, Eq(0u));
+    for (auto i = 0u; i < figures.size(); ++i)
+        ASSERT_THAT(copies[i]->area(), Eq(figures[i]->area()));
+}
+
+TEST_F(FigureHeapTests_v5, clone_into_inplace_storage_makes_no_allocation)
+{
+    auto square = Square{};
+    alignas(std::max_align_t) unsigned char storage[sizeof(Square)];
+
+    auto copy  = object::clone_into(square, storage, sizeof(storage));
+    auto value = object::inplace<Figure, sizeof(Square)>{square};
+    auto other = value;
+
+    ASSERT_THAT(allocations(), Eq(0u));
+}
+
+TEST_F(FigureHeapTests_v5, copy_of_inline_poly_value_allocates_nothing)
+{
+    auto square = object::poly_value<Figure>{Square{2.}};
+    ASSERT_TRUE(square.is_inline());
+
+    auto area   = 0.;
+    auto copies = allocations_of([&]
+    {
+        auto copy = square;
+        area = copy->area();
+    });
+
+    ASSERT_THAT(copies, Eq(0u));
+    ASSERT_THAT(area, Eq(4.));
+}
+
+TEST_F(FigureHeapTests_v5, clone_shared_makes_one_allocation)
+{
+    auto square = SharedSquare{};
+    object::clone_shared(square);
+
+    auto copies = allocations_of([&]
+    {
+        auto copy  = object::clone_shared(square);
+        auto other = copy;
+    });
+
+    ASSERT_THAT(copies, Eq(1u));
+}
+
+TEST_F(FigureHeapTests_v5, clone_of_closed_figure_allocates_nothing)
+{
+    auto figure = closed_figure<Square, Rectangle>{Rectangle{1., 2.}};
+
+    auto copy = object::clone(figure);
+
+    ASSERT_THAT(allocations(), Eq(0u));
+}
+
+TEST_F(FigureHeapTests_v5, clone_into_reset_generation_arena_allocates_nothing)
+{
+    auto square = FinalSquare{};
+    object::generation_arena arena;
+    object::clone(square, arena);
+    arena.reset();
+
+    auto copies = allocations_of([&]
+    {
+        for (auto i = 0; i < 100; ++i)
+            object::clone(square, arena);
+    });
+
+    ASSERT_THAT(copies, Eq(0u));
+}
+
+TEST_F(FigureHeapTests_v5, pooled_clone_reuses_released_slot)
+{
+    auto square = PooledSquare<object::thread_local_pool>{};
+    object::clone(square);
+
+    auto copies = allocations_of([&]
+    {
+        auto copy = object::clone(square);
+    });
+
+    ASSERT_THAT(copies, Eq(0u));
+}
+
+TEST(FigureTests_v5, offset_ptr_points_relative_to_itself)
+{
+    struct node
+    {
+        double                     value;
+        object::offset_ptr<double> self;
+    };
+    auto first = node{1., nullptr};
+    first.self = &first.value;
+    object::offset_ptr<double> empty;
+
+    ASSERT_THAT(first.self.get(), Eq(&first.value));
+    ASSERT_FALSE(empty);
+    ASSERT_THAT(empty.get(), IsNull());
+}
+
+#if defined(__unix__)
+std::string segment_name(const char* suffix)
+{
+    return "/figure-tests-" + std::to_string(::getpid()) + "-" + suffix;
+}
+
+TEST(FigureTests_v5, snapshot_published_to_shared_segment_is_read_through_other_mapping)
+{
+    auto name    = segment_name("snapshot");
+    auto figures = make_squares(4);
+    auto segment = object::publish_snapshot(name, figures.begin(), figures.end());
+
+    auto worker = object::shared_segment::open(name);
+    object::shared_segment::remove(name);
+
+    ASSERT_THAT(worker.data(), Ne(segment.data()));
+    ASSERT_THAT(worker.size(), Eq(segment.size()));
+    ASSERT_THAT(FigureView(worker.data(), worker.size()).total_area(), Eq(0. + 1 + 4 + 9));
+}
+
+TEST(FigureTests_v5, clone_into_shared_segment_is_reachable_through_offset_ptr_in_other_mapping)
+{
+    auto name    = segment_name("clone");
+    auto segment = object::shared_segment::create(name, 4096);
+    auto root    = ::new (segment.data()) object::offset_ptr<const Figure>;
+    auto storage = static_cast<unsigned char*>(segment.data()) + 64;
+    *root = object::clone_into(Square{3.}, storage, segment.size() - 64).release();
+
+    auto worker = object::shared_segment::open(name);
+    object::shared_segment::remove(name);
+    auto figure = static_cast<const object::offset_ptr<const Figure>*>(worker.data());
+
+    ASSERT_THAT(figure->get(), Ne(root->get()));
+    ASSERT_THAT((*figure)->area(), Eq(9.));
+}
+
+TEST(FigureTests_v5, opening_missing_shared_segment_throws)
+{
+    ASSERT_THROW(object::shared_segment::open(segment_name("missing")), std::system_error);
+}
+#endif
+
 } // v5 namespace
@@ -0,0 +1,3420 @@
+#ifndef FIGURES_V5_H
+#define FIGURES_V5_H
+
+#include <type_traits>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#if defined(OBJECT_CLONE_INSTRUMENTATION) || defined(OBJECT_CLONE_SAMPLING)
+#include <chrono>
+#endif
+
+#if defined(OBJECT_CLONE_SAMPLING)
+#include <ostream>
+#include <sstream>
+#endif
+
+#if defined(__unix__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FIGURE_STORE_SIMD
+#include <immintrin.h>
+#endif
+
+// object library of v5 and figures built on it - shared by FigureTests-v5.cpp and benchmarks
+namespace v5 {
+
+namespace object
+{
+#if defined(OBJECT_CLONE_INSTRUMENTATION)
+    namespace instrumentation
+    {
+        // bucket i counts clones which took [2^i, 2^(i+1)) nanoseconds
+        constexpr std::size_t latency_buckets = 32;
+
+        struct clone_stats
+        {
+            std::type_index type;
+            std::size_t     clones = 0;
+            std::size_t     bytes  = 0;
+            std::array<std::size_t, latency_buckets> latency{};
+        };
+
+        using clock = std::chrono::steady_clock;
+
+        inline std::mutex& stats_mutex()
+        {
+            static std::mutex m;
+            return m;
+        }
+
+        inline std::unordered_map<std::type_index, clone_stats>& stats()
+        {
+            static std::unordered_map<std::type_index, clone_stats> table;
+            return table;
+        }
+
+        inline void record(const std::type_info& type, std::size_t bytes, clock::time_point start)
+        {
+            auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count();
+            auto bucket = std::size_t{0};
+            while (nanoseconds >>= 1)
+                ++bucket;
+
+            std::lock_guard<std::mutex> lock{stats_mutex()};
+            auto& entry = stats().try_emplace(type, clone_stats{type}).first->second;     // no node allocated for known type
+            entry.clones += 1;
+            entry.bytes  += bytes;
+            entry.latency[std::min(bucket, latency_buckets - 1)] += 1;
+        }
+
+        // counters of every cloned dynamic type since start or last reset()
+        inline std::vector<clone_stats> snapshot()
+        {
+            std::lock_guard<std::mutex> lock{stats_mutex()};
+            std::vector<clone_stats> result;
+            for (auto& entry : stats())
+                result.push_back(entry.second);
+            return result;
+        }
+
+        inline void reset()
+        {
+            std::lock_guard<std::mutex> lock{stats_mutex()};
+            stats().clear();
+        }
+    }
+#endif
+
+#if defined(OBJECT_CLONE_SAMPLING)
+    // every period-th object::clone of a thread is recorded into a ring of the last ring_capacity samples
+    namespace sampling
+    {
+        constexpr std::size_t ring_capacity = 4096;
+
+        using clock = std::chrono::steady_clock;
+
+        struct sample
+        {
+            const char*           tag;      // innermost sampling::scope of cloning thread or nullptr
+            const std::type_info* type;
+            std::size_t           bytes;
+            clock::time_point     start;
+            clock::duration       duration;
+            std::uint32_t         thread;   // small sequential id, 1 for first sampled thread
+        };
+
+        inline std::atomic<std::uint32_t>& period()
+        {
+            static std::atomic<std::uint32_t> every{1024};
+            return every;
+        }
+
+        inline void set_period(std::uint32_t every)
+        {
+            period().store(std::max(every, std::uint32_t{1}), std::memory_order_relaxed);
+        }
+
+        inline thread_local const char*   current_tag = nullptr;
+        inline thread_local std::uint32_t countdown   = 0;
+
+        // tags clones made by this thread until destruction
+        class scope
+        {
+            const char* previous;
+
+        public:
+            explicit scope(const char* tag) : previous{current_tag}
+            {
+                current_tag = tag;
+            }
+
+            scope(const scope&) = delete;
+            scope& operator=(const scope&) = delete;
+
+            ~scope()
+            {
+                current_tag = previous;
+            }
+        };
+
+        // one thread local decrement per clone - clock is read only for sampled ones
+        inline bool should_sample()
+        {
+            if (countdown)
+            {
+                --countdown;
+                return false;
+            }
+            countdown = period().load(std::memory_order_relaxed) - 1;
+            return true;
+        }
+
+        struct ring
+        {
+            std::mutex                              mutex;
+            std::array<sample, ring_capacity>       samples;
+            std::size_t                             written = 0;
+        };
+
+        inline ring& samples_ring()
+        {
+            static ring samples;
+            return samples;
+        }
+
+        inline std::uint32_t thread_id()
+        {
+            static std::atomic<std::uint32_t> threads{0};
+            static thread_local const std::uint32_t id = threads.fetch_add(1, std::memory_order_relaxed) + 1;
+            return id;
+        }
+
+        inline void record(const std::type_info& type, std::size_t bytes, clock::time_point start)
+        {
+            auto taken  = sample{current_tag, &type, bytes, start, clock::now() - start,
+                                 thread_id()};
+            auto& into  = samples_ring();
+            std::lock_guard<std::mutex> lock{into.mutex};
+            into.samples[into.written++ % ring_capacity] = taken;
+        }
+
+        // retained samples, oldest first
+        inline std::vector<sample> snapshot()
+        {
+            auto& from = samples_ring();
+            std::lock_guard<std::mutex> lock{from.mutex};
+            auto count = std::min(from.written, ring_capacity);
+            std::vector<sample> result;
+            for (auto i = from.written - count; i < from.written; ++i)
+                result.push_back(from.samples[i % ring_capacity]);
+            return result;
+        }
+
+        inline void reset()
+        {
+            auto& from = samples_ring();
+            std::lock_guard<std::mutex> lock{from.mutex};
+            from.written = 0;
+            countdown    = 0;
+        }
+
+        // retained samples as Chrome trace event JSON - loads in chrome://tracing and Perfetto
+        inline void write_trace(std::ostream& out)
+        {
+            auto microseconds = [](clock::duration duration)
+            {
+                return std::chrono::duration<double, std::micro>(duration).count();
+            };
+            auto escaped = [](const char* text)
+            {
+                std::ostringstream result;
+                for (; *text; ++text)
+                    if (*text == '"' || *text == '\\')
+                        result << '\\' << *text;
+                    else if (static_cast<unsigned char>(*text) >= 0x20)
+                        result << *text;
+                return result.str();
+            };
+
+            out << "{\"traceEvents\":[";
+            auto first = true;
+            for (auto& taken : snapshot())
+            {
+                out << (first ? "" : ",")
+                    << "{\"name\":\"" << escaped(taken.type->name()) << "\",\"cat\":\"clone\",\"ph\":\"X\""
+                    << ",\"ts\":"  << microseconds(taken.start.time_since_epoch())
+                    << ",\"dur\":" << microseconds(taken.duration)
+                    << ",\"pid\":0,\"tid\":" << taken.thread
+                    << ",\"args\":{\"bytes\":" << taken.bytes
+                    << ",\"tag\":\"" << escaped(taken.tag ? taken.tag : "") << "\"}}";
+                first = false;
+            }
+            out << "]}";
+        }
+    }
+
+// tags clones of enclosing block with its file and line
+#define OBJECT_CLONE_SAMPLING_STRING(x) #x
+#define OBJECT_CLONE_SAMPLING_SITE(line) __FILE__ ":" OBJECT_CLONE_SAMPLING_STRING(line)
+#define OBJECT_CLONE_SAMPLING_SCOPE() ::v5::object::sampling::scope object_clone_sampling_scope{OBJECT_CLONE_SAMPLING_SITE(__LINE__)}
+#endif
+
+    template<typename T>
+    struct resource_deleter
+    {
+        std::pmr::memory_resource* resource = nullptr;
+
+        resource_deleter() = default;
+        resource_deleter(std::pmr::memory_resource& resource) : resource{&resource}{}
+
+        template<typename U, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+        resource_deleter(const resource_deleter<U>& other) : resource{other.resource}{}
+
+        void operator()(T* object) const
+        {
+            using base_type = typename T::base_type;
+            auto& base      = static_cast<const base_type&>(*object);
+            auto  size      = base.size_of();
+            auto  alignment = base.align_of();
+            auto  storage   = const_cast<void*>(dynamic_cast<const void*>(object));
+            object->~T();
+            resource->deallocate(storage, size, alignment);
+        }
+    };
+
+    template<typename T>
+    using resource_ptr = std::unique_ptr<T, resource_deleter<T>>;
+
+    // destroys object placed in caller-owned storage, storage itself is not released
+    template<typename T>
+    struct placement_deleter
+    {
+        placement_deleter() = default;
+
+        template<typename U, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+        placement_deleter(const placement_deleter<U>&){}
+
+        void operator()(T* object) const
+        {
+            object->~T();
+        }
+    };
+
+    template<typename T>
+    using placed_ptr = std::unique_ptr<T, placement_deleter<T>>;
+
+    template<typename T>
+    std::unique_ptr<T> clone(const T& object)
+    {
+        using base_type = typename T::base_type;
+        static_assert(std::is_base_of<base_type, T>::value, "T object has to derived from T::base_type");
+#if defined(OBJECT_CLONE_INSTRUMENTATION)
+        auto start = instrumentation::clock::now();
+#endif
+#if defined(OBJECT_CLONE_SAMPLING)
+        auto sampled = sampling::should_sample();
+        auto sampled_start = sampled ? sampling::clock::now() : sampling::clock::time_point{};
+#endif
+        T* ptr = nullptr;
+        if constexpr (std::is_final<T>::value)
+            ptr = new T(object);    // dynamic type of final T is T - no virtual call needed
+        else
+            ptr = static_cast<T*>(static_cast<const base_type&>(object).clone());
+#if defined(OBJECT_CLONE_SAMPLING)
+        if (sampled)
+            sampling::record(typeid(*ptr), static_cast<const base_type&>(*ptr).size_of(), sampled_start);
+#endif
+#if defined(OBJECT_CLONE_INSTRUMENTATION)
+        instrumentation::record(typeid(*ptr), static_cast<const base_type&>(*ptr).size_of(), start);
+#endif
+        return std::unique_ptr<T>(ptr);
+    }
+
+    template<typename T>
+    auto clone(T* object) -> decltype(clone(*object))
+    {
+        return clone(*object);
+    }
+
+    template<typename T,
+             typename = typename std::enable_if<!std::is_lvalue_reference<T>::value && !std::is_const<T>::value && std::is_class<T>::value>::type>
+    std::unique_ptr<T> clone(T&& object)
+    {
+        using base_type = typename T::base_type;
+        static_assert(std::is_base_of<base_type, T>::value, "T object has to derived from T::base_type");
+#if defined(OBJECT_CLONE_INSTRUMENTATION)
+        auto start = instrumentation::clock::now();
+#endif
+        T* ptr = nullptr;
+        if constexpr (std::is_final<T>::value)
+            ptr = new T(std::move(object));
+        else
+            ptr = static_cast<T*>(static_cast<base_type&>(object).move_clone());
+#if defined(OBJECT_CLONE_INSTRUMENTATION)
+        instrumentation::record(typeid(*ptr), static_cast<const base_type&>(*ptr).size_of(), start);
+#endif
+        return std::unique_ptr<T>(ptr);
+    }
+
+    template<typename T>
+    resource_ptr<T> clone(const T& object, std::pmr::memory_resource& resource)
+    {
+        using base_type = typename T::base_type;
+        static_assert(std::is_base_of<base_type, T>::value, "T object has to derived from T::base_type");
+#if defined(OBJECT_CLONE_INSTRUMENTATION)
+        auto start = instrumentation::clock::now();
+#endif
+        T* ptr = nullptr;
+        auto& base = static_cast<const base_type&>(object);
+        auto size      = std::is_final<T>::value ? sizeof(T)  : base.size_of();
+        auto alignment = std::is_final<T>::value ? alignof(T) : base.align_of();
+        auto storage   = resource.allocate(size, alignment);
+        try
+        {
+            if constexpr (std::is_final<T>::value)
+                ptr = ::new (storage) T(object);
+            else
+                ptr = static_cast<T*>(base.clone_into(storage));
+        }
+        catch (...)
+        {
+            resource.deallocate(storage, size, alignment);
+            throw;
+        }
+#if defined(OBJECT_CLONE_INSTRUMENTATION)
+        instrumentation::record(typeid(*ptr), size, start);
+#endif
+        return resource_ptr<T>(ptr, resource_deleter<T>{resource});
+    }
+
+    template<typename T>
+    auto clone(T* object, std::pmr::memory_resource& resource) -> decltype(clone(*object, resource))
+    {
+        return clone(*object, resource);
+    }
+
+    // bytes and alignment which storage for clone of object needs
+    template<typename T>
+    std::size_t size_of(const T& object)
+    {
+        using base_type = typename T::base_type;
+        return static_cast<const base_type&>(object).size_of();
+    }
+
+    template<typename T>
+    std::size_t align_of(const T& object)
+    {
+        using base_type = typename T::base_type;
+        return static_cast<const base_type&>(object).align_of();
+    }
+
+    // clones object into caller-owned storage of size bytes - returned pointer destroys it but does not free storage
+    template<typename T>
+    placed_ptr<T> clone_into(const T& object, void* storage, std::size_t size)
+    {
+        using base_type = typename T::base_type;
+        static_assert(std::is_base_of<base_type, T>::value, "T object has to derived from T::base_type");
+        auto& base = static_cast<const base_type&>(object);
+        if (size < base.size_of() || reinterpret_cast<std::uintptr_t>(storage) % base.align_of())
+            throw std::length_error("storage is too small or misaligned for object");
+        return placed_ptr<T>(static_cast<T*>(base.clone_into(storage)));
+    }
+
+    template<typename T>
+    auto clone_into(T* object, void* storage, std::size_t size) -> decltype(clone_into(*object, storage, size))
+    {
+        return clone_into(*object, storage, size);
+    }
+
+    // clone of polymorphic T kept in own storage of Size bytes - copies are cloned into storage of copy
+    template<typename T, std::size_t Size, std::size_t Align = alignof(std::max_align_t)>
+    class inplace
+    {
+        alignas(Align) unsigned char storage[Size];
+        placed_ptr<T> object;
+
+    public:
+        inplace() = default;
+
+        explicit inplace(const T& source) : object{clone_into(source, storage, Size)}{}
+
+        inplace(const inplace& other) : object{other ? clone_into(*other, storage, Size) : nullptr}{}
+
+        inplace& operator=(const inplace& other)
+        {
+            if (this != &other)
+            {
+                object.reset();
+                if (other)
+                    object = clone_into(*other, storage, Size);
+            }
+            return *this;
+        }
+
+        T& operator*() const
+        {
+            return *object;
+        }
+
+        T* operator->() const
+        {
+            return object.get();
+        }
+
+        T* get() const
+        {
+            return object.get();
+        }
+
+        explicit operator bool() const
+        {
+            return object != nullptr;
+        }
+
+        void reset()
+        {
+            object.reset();
+        }
+    };
+
+    // objects whose destructor has no effect - generation_arena does not run it on reset,
+    // specialize for final polymorphic types whose only non-trivial part is virtual destructor
+    template<typename T>
+    struct trivially_droppable : std::is_trivially_destructible<T>{};
+
+    // bump allocator for clones of one generation - reset() destroys them all at once and keeps its blocks
+    class generation_arena
+    {
+        struct block
+        {
+            std::unique_ptr<unsigned char[]> bytes;
+            std::size_t                      size;
+        };
+
+        using destroy_function = void (*)(void*);
+
+        std::size_t         block_size;
+        std::vector<block>  blocks;
+        std::size_t         current = 0;     // block bumped from
+        std::size_t         used    = 0;     // bytes of current block
+        std::shared_ptr<std::uint32_t> number = std::make_shared<std::uint32_t>(0);   // shared with arena_ptr, outlives arena
+        std::vector<std::pair<void*, destroy_function>> destructors;
+
+        template<typename T>
+        friend class arena_ptr;
+
+    public:
+        explicit generation_arena(std::size_t block_size = 64 * 1024) : block_size{block_size}{}
+
+        generation_arena(const generation_arena&) = delete;
+        generation_arena& operator=(const generation_arena&) = delete;
+
+        // arena_ptr of destroyed arena become stale as after reset()
+        ~generation_arena()
+        {
+            destroy();
+            ++*number;
+        }
+
+        void* allocate(std::size_t size, std::size_t alignment)
+        {
+            for (;; ++current, used = 0)
+            {
+                if (current == blocks.size())
+                {
+                    auto bytes = std::max(block_size, size + alignment);
+                    blocks.push_back(block{std::unique_ptr<unsigned char[]>(new unsigned char[bytes]), bytes});
+                }
+                void* storage = blocks[current].bytes.get() + used;
+                auto  space   = blocks[current].size - used;
+                if (std::align(alignment, size, storage, space))
+                {
+                    used = blocks[current].size - space + size;
+                    return storage;
+                }
+            }
+        }
+
+        // object is destroyed by next reset()
+        template<typename T>
+        void destroy_on_reset(T* object)
+        {
+            destructors.emplace_back(object, [](void* object) { static_cast<T*>(object)->~T(); });
+        }
+
+        // destroys every clone of this generation - arena_ptr of it become stale
+        void reset()
+        {
+            destroy();
+            current = 0;
+            used    = 0;
+            ++*number;
+        }
+
+        std::uint32_t generation() const
+        {
+            return *number;
+        }
+
+        std::size_t capacity() const
+        {
+            auto bytes = std::size_t{0};
+            for (auto& owned : blocks)
+                bytes += owned.size;
+            return bytes;
+        }
+
+    private:
+        void destroy()
+        {
+            for (auto it = destructors.rbegin(); it != destructors.rend(); ++it)
+                it->second(it->first);
+            destructors.clear();
+        }
+    };
+
+    // non-owning pointer to clone of generation_arena - plain pointer when NDEBUG is defined,
+    // otherwise dereferencing it after arena reset or destruction throws std::logic_error
+    template<typename T>
+    class arena_ptr
+    {
+        T* object = nullptr;
+#if !defined(NDEBUG)
+        std::shared_ptr<const std::uint32_t> arena;         // generation of arena, kept alive by its pointers
+        std::uint32_t                        generation = 0;
+#endif
+
+        template<typename U>
+        friend class arena_ptr;
+
+    public:
+        arena_ptr() = default;
+
+#if defined(NDEBUG)
+        arena_ptr(T* object, const generation_arena&) : object{object}{}
+
+        template<typename U, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+        arena_ptr(const arena_ptr<U>& other) : object{other.object}{}
+#else
+        arena_ptr(T* object, const generation_arena& arena) : object{object}, arena{arena.number}, generation{arena.generation()}{}
+
+        template<typename U, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+        arena_ptr(const arena_ptr<U>& other) : object{other.object}, arena{other.arena}, generation{other.generation}{}
+
+        // clone is still alive - checked builds only
+        bool valid() const
+        {
+            return object && *arena == generation;
+        }
+#endif
+
+        T* get() const
+        {
+#if !defined(NDEBUG)
+            if (object && !valid())
+                throw std::logic_error("arena_ptr used after generation_arena::reset or destruction");
+#endif
+            return object;
+        }
+
+        T& operator*() const
+        {
+            return *get();
+        }
+
+        T* operator->() const
+        {
+            return get();
+        }
+
+        explicit operator bool() const
+        {
+            return object != nullptr;
+        }
+    };
+
+    template<typename T>
+    struct cloneable
+    {
+        using base_type = T;
+
+        virtual ~cloneable() = default;
+    protected:
+        virtual T* clone() const = 0;
+
+        // moves state of expiring object into the copy
+        virtual T* move_clone() = 0;
+
+        // storage needed by dynamic type and copy-construction into such storage
+        virtual std::size_t size_of()  const = 0;
+        virtual std::size_t align_of() const = 0;
+        virtual T* clone_into(void* storage) const = 0;
+
+        template <typename X>
+        friend std::unique_ptr<X> object::clone(const X&);
+
+        template <typename X, typename Y>
+        friend std::unique_ptr<X> object::clone(X&&);
+
+        template <typename X>
+        friend resource_ptr<X> object::clone(const X&, std::pmr::memory_resource&);
+
+        template <typename X>
+        friend struct resource_deleter;
+
+        template <typename X>
+        friend std::size_t object::size_of(const X&);
+
+        template <typename X>
+        friend std::size_t object::align_of(const X&);
+
+        template <typename X>
+        friend placed_ptr<X> object::clone_into(const X&, void*, std::size_t);
+    };
+
+    // implements every cloneable hook for Derived which inherits Base through it:
+    //     struct Square : object::cloneable_impl<Square, Figure> { ... };
+    // hooks return Base* as Derived is incomplete here - object::clone restores static type,
+    // leaf types declared final are copied by object::clone without virtual call
+    template<typename Derived, typename Base>
+    struct cloneable_impl : Base
+    {
+        using Base::Base;
+
+    protected:
+        Base* clone() const override
+        {
+            return new Derived(self());
+        }
+
+        Base* move_clone() override
+        {
+            return new Derived(std::move(self()));
+        }
+
+        std::size_t size_of() const override
+        {
+            return sizeof(Derived);
+        }
+
+        std::size_t align_of() const override
+        {
+            return alignof(Derived);
+        }
+
+        Base* clone_into(void* storage) const override
+        {
+            return ::new (storage) Derived(self());
+        }
+
+    private:
+        const Derived& self() const
+        {
+            return static_cast<const Derived&>(*this);
+        }
+
+        Derived& self()
+        {
+            return static_cast<Derived&>(*this);
+        }
+    };
+
+    namespace detail
+    {
+        // recycled slots of one size class - not synchronized
+        class freelist
+        {
+            struct slot
+            {
+                slot* next;
+            };
+
+            slot* head = nullptr;
+
+        public:
+            freelist() = default;
+            freelist(const freelist&) = delete;
+            freelist& operator=(const freelist&) = delete;
+
+            ~freelist()
+            {
+                while (head)
+                    ::operator delete(pop_slot());
+            }
+
+            void* pop(std::size_t size)
+            {
+                return head ? pop_slot() : ::operator new(size);
+            }
+
+            void push(void* p)
+            {
+                head = ::new (p) slot{head};
+            }
+
+        private:
+            slot* pop_slot()
+            {
+                auto s = head;
+                head = head->next;
+                return s;
+            }
+        };
+    }
+
+    // one freelist per type shared by all threads
+    struct shared_pool
+    {
+        template<typename T>
+        static void* allocate()
+        {
+            std::lock_guard<std::mutex> lock{mutex<T>()};
+            return slots<T>().pop(sizeof(T));
+        }
+
+        template<typename T>
+        static void deallocate(void* p)
+        {
+            std::lock_guard<std::mutex> lock{mutex<T>()};
+            slots<T>().push(p);
+        }
+
+    private:
+        template<typename T>
+        static detail::freelist& slots()
+        {
+            static detail::freelist list;
+            return list;
+        }
+
+        template<typename T>
+        static std::mutex& mutex()
+        {
+            static std::mutex m;
+            return m;
+        }
+    };
+
+    // one freelist per type and thread - slot freed on other thread stays there
+    struct thread_local_pool
+    {
+        template<typename T>
+        static void* allocate()
+        {
+            return slots<T>().pop(sizeof(T));
+        }
+
+        template<typename T>
+        static void deallocate(void* p)
+        {
+            slots<T>().push(p);
+        }
+
+    private:
+        template<typename T>
+        static detail::freelist& slots()
+        {
+            static thread_local detail::freelist list;
+            return list;
+        }
+    };
+
+    // inherited by concrete type T - new/delete of exactly sizeof(T) go through Policy
+    template<typename T, typename Policy = shared_pool>
+    struct pooled
+    {
+        static void* operator new(std::size_t size)
+        {
+            static_assert(sizeof(T) >= sizeof(void*), "T object is too small for pool slot");
+            return size == sizeof(T) ? Policy::template allocate<T>() : ::operator new(size);
+        }
+
+        static void operator delete(void* p, std::size_t size)
+        {
+            if (size == sizeof(T))
+                Policy::template deallocate<T>(p);
+            else
+                ::operator delete(p);
+        }
+    };
+
+    namespace detail
+    {
+        // hands out count consecutive slots of slot_size bytes to objects of the same type - resource itself lives
+        // in front of the slots in one upstream block which is released when run and all its slots are released
+        class run_resource : public std::pmr::memory_resource
+        {
+            std::pmr::memory_resource& upstream;
+            std::size_t    count;
+            std::size_t    slot_size;
+            std::size_t    alignment;
+            std::size_t    header;
+            unsigned char* slots;
+            std::size_t    used = 0;
+            std::size_t    live = 1;  // run itself
+
+            run_resource(std::pmr::memory_resource& upstream, std::size_t count, std::size_t slot_size, std::size_t alignment, std::size_t header)
+                : upstream(upstream), count{count}, slot_size{slot_size}, alignment{alignment}, header{header},
+                  slots{reinterpret_cast<unsigned char*>(this) + header}{}
+
+        public:
+            struct release_run
+            {
+                void operator()(run_resource* run) const
+                {
+                    run->release();
+                }
+            };
+
+            static std::unique_ptr<run_resource, release_run> make(std::pmr::memory_resource& upstream, std::size_t count,
+                                                                   std::size_t slot_size, std::size_t alignment)
+            {
+                alignment   = std::max(alignment, alignof(run_resource));
+                auto header = (sizeof(run_resource) + alignment - 1) / alignment * alignment;
+                auto block  = upstream.allocate(header + slot_size * count, alignment);
+                return std::unique_ptr<run_resource, release_run>(::new (block) run_resource(upstream, count, slot_size, alignment, header));
+            }
+
+        private:
+            bool in_block(void* p) const
+            {
+                auto address = static_cast<unsigned char*>(p);
+                return address >= slots && address < slots + slot_size * count;
+            }
+
+            void release()
+            {
+                if (--live)
+                    return;
+                auto& from  = upstream;
+                auto  bytes = header + slot_size * count;
+                auto  align = alignment;
+                this->~run_resource();
+                from.deallocate(this, bytes, align);
+            }
+
+            void* do_allocate(std::size_t bytes, std::size_t align) override
+            {
+                ++live;
+                if (bytes == slot_size && align <= alignment && used < count)
+                    return slots + slot_size * used++;
+                return upstream.allocate(bytes, align);
+            }
+
+            void do_deallocate(void* p, std::size_t bytes, std::size_t align) override
+            {
+                if (!in_block(p))
+                    upstream.deallocate(p, bytes, align);
+                release();
+            }
+
+            bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+            {
+                return this == &other;
+            }
+        };
+    }
+
+    // clones every object pointed by [first, last)
+    template<typename InputIt, typename OutputIt>
+    OutputIt clone_all(InputIt first, InputIt last, OutputIt out)
+    {
+        for (; first != last; ++first)
+            *out++ = clone(**first);
+        return out;
+    }
+
+    // as above but objects of the same dynamic type share one allocation from resource - first grouped_types
+    // types of range are grouped, objects of other types or alone in range are cloned one by one into resource
+    template<typename ForwardIt, typename OutputIt>
+    OutputIt clone_all(ForwardIt first, ForwardIt last, OutputIt out, std::pmr::memory_resource& resource)
+    {
+        constexpr std::size_t grouped_types = 16;
+
+        struct group
+        {
+            const std::type_info* type  = nullptr;
+            std::size_t           count = 0;
+            std::unique_ptr<detail::run_resource, detail::run_resource::release_run> run;
+        };
+
+        std::array<group, grouped_types> groups;
+        auto find = [&](const std::type_info& type) -> group*
+        {
+            for (auto& candidate : groups)
+                if (!candidate.type || *candidate.type == type)
+                    return candidate.type ? &candidate : nullptr;
+            return nullptr;
+        };
+
+        for (auto it = first; it != last; ++it)
+        {
+            auto& type = typeid(**it);
+            if (auto found = find(type))
+                ++found->count;
+            else
+                for (auto& candidate : groups)
+                    if (!candidate.type)
+                    {
+                        candidate = group{&type, 1};
+                        break;
+                    }
+        }
+
+        for (; first != last; ++first)
+        {
+            auto found = find(typeid(**first));
+            if (!found || found->count == 1)
+            {
+                *out++ = clone(**first, resource);
+                continue;
+            }
+            if (!found->run)
+                found->run = detail::run_resource::make(resource, found->count, size_of(**first), align_of(**first));
+            *out++ = clone(**first, *found->run);
+        }
+        return out;
+    }
+
+    // calls visit(type, objects, positions, count) once per dynamic type of objects pointed by [first, last) -
+    // objects holds count pointers to objects of that type and positions their offsets in range
+    template<typename ForwardIt, typename Visitor>
+    void for_each_sorted(ForwardIt first, ForwardIt last, Visitor visit)
+    {
+        using object_type = typename std::remove_reference<decltype(**first)>::type;
+        using base_type   = typename object_type::base_type;
+
+        struct bucket
+        {
+            const std::type_info*        type;
+            std::vector<const base_type*> objects;
+            std::vector<std::size_t>      positions;
+        };
+
+        std::vector<bucket> buckets;
+        std::unordered_map<std::type_index, std::size_t> index;
+        auto last_type = static_cast<const std::type_info*>(nullptr);
+        auto current   = std::size_t{0};
+        for (std::size_t position = 0; first != last; ++first, ++position)
+        {
+            const base_type& object = **first;
+            auto& type = typeid(object);
+            if (!last_type || type != *last_type)     // runs of one type skip hash lookup
+            {
+                auto found = index.try_emplace(type, buckets.size());
+                if (found.second)
+                    buckets.push_back(bucket{&type});
+                current   = found.first->second;
+                last_type = &type;
+            }
+            buckets[current].objects.push_back(&object);
+            buckets[current].positions.push_back(position);
+        }
+
+        for (auto& sorted : buckets)
+            visit(*sorted.type, sorted.objects.data(), sorted.positions.data(), sorted.objects.size());
+    }
+
+    // splits cloned range into chunks claimed by worker threads - 0 threads means one per core,
+    // 0 chunk_size means default chunk size
+    struct parallel_policy
+    {
+        unsigned    threads    = 0;
+        std::size_t chunk_size = 1024;
+    };
+
+    constexpr parallel_policy par{};
+
+    namespace detail
+    {
+        inline std::size_t chunk_size(const parallel_policy& policy)
+        {
+            return policy.chunk_size ? policy.chunk_size : parallel_policy{}.chunk_size;
+        }
+
+        inline std::size_t worker_count(const parallel_policy& policy, std::size_t limit, std::size_t size)
+        {
+            auto chunks  = (size + chunk_size(policy) - 1) / chunk_size(policy);
+            auto workers = limit ? limit : std::max(1u, std::thread::hardware_concurrency());
+            return std::max<std::size_t>(1, std::min<std::size_t>(workers, chunks));
+        }
+
+        // calls work(worker, begin, end) for chunks of [0, size) claimed by workers on demand,
+        // calling thread is worker 0 and first exception is rethrown after all workers finish
+        template<typename Work>
+        void for_each_chunk(const parallel_policy& policy, std::size_t workers, std::size_t size, Work work)
+        {
+            std::atomic<std::size_t> next{0};
+            std::exception_ptr       error;
+            std::mutex               error_mutex;
+            auto                     chunk = chunk_size(policy);
+
+            auto worker = [&](std::size_t index)
+            {
+                try
+                {
+                    for (auto begin = next.fetch_add(chunk); begin < size; begin = next.fetch_add(chunk))
+                        work(index, begin, std::min(begin + chunk, size));
+                }
+                catch (...)
+                {
+                    next = size;
+                    std::lock_guard<std::mutex> lock{error_mutex};
+                    if (!error)
+                        error = std::current_exception();
+                }
+            };
+
+            std::vector<std::thread> threads;
+            for (auto index = 1u; index < workers; ++index)
+                threads.emplace_back(worker, index);
+            worker(0);
+            for (auto& thread : threads)
+                thread.join();
+
+            if (error)
+                std::rethrow_exception(error);
+        }
+
+        inline std::pmr::memory_resource& as_resource(std::pmr::memory_resource& resource)
+        {
+            return resource;
+        }
+
+        inline std::pmr::memory_resource& as_resource(std::pmr::memory_resource* resource)
+        {
+            return *resource;
+        }
+    }
+
+    // clones are written to out in source order, out has to be random access
+    template<typename RandomIt, typename RandomOutIt>
+    RandomOutIt clone_all(const parallel_policy& policy, RandomIt first, RandomIt last, RandomOutIt out)
+    {
+        std::size_t size = last - first;
+        detail::for_each_chunk(policy, detail::worker_count(policy, policy.threads, size), size,
+            [&](std::size_t, std::size_t begin, std::size_t end)
+            {
+                clone_all(first + begin, first + end, out + begin);
+            });
+        return out + size;
+    }
+
+    // one worker per resource in resources - worker allocates only from its own resource,
+    // empty resources means calling thread alone clones into default resource
+    template<typename RandomIt, typename RandomOutIt, typename Resources>
+    RandomOutIt clone_all(const parallel_policy& policy, RandomIt first, RandomIt last, RandomOutIt out, Resources& resources)
+    {
+        std::size_t size = last - first;
+        if (std::begin(resources) == std::end(resources))
+            return clone_all(first, last, out, *std::pmr::get_default_resource());
+
+        auto workers = std::min<std::size_t>(std::distance(std::begin(resources), std::end(resources)),
+                                             detail::worker_count(policy, policy.threads, size));
+        detail::for_each_chunk(policy, workers, size,
+            [&](std::size_t worker, std::size_t begin, std::size_t end)
+            {
+                auto& resource = detail::as_resource(*std::next(std::begin(resources), worker));
+                clone_all(first + begin, first + end, out + begin, resource);
+            });
+        return out + size;
+    }
+
+    // memory nodes of machine - without NUMA support everything is node 0
+    namespace numa
+    {
+        inline int node_count()
+        {
+#if defined(__linux__)
+            static const int count = []
+            {
+                unsigned long allowed[16] = {};
+                if (::syscall(SYS_get_mempolicy, nullptr, allowed, sizeof(allowed) * 8, nullptr, MPOL_F_MEMS_ALLOWED) != 0)
+                    return 1;
+                auto highest = 0;
+                for (auto node = 0; node < int(sizeof(allowed) * 8); ++node)
+                    if (allowed[node / 64] >> (node % 64) & 1)
+                        highest = node;
+                return highest + 1;
+            }();
+            return count;
+#else
+            return 1;
+#endif
+        }
+
+        // node of cpu the calling thread runs on - glibc getcpu is served by vDSO without entering kernel
+        inline int current_node()
+        {
+#if defined(__linux__)
+            unsigned cpu = 0, node = 0;
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29))
+            if (::getcpu(&cpu, &node) == 0)
+#else
+            if (::syscall(SYS_getcpu, &cpu, &node, nullptr) == 0)
+#endif
+                return static_cast<int>(node);
+#endif
+            return 0;
+        }
+
+        // node of page holding address or -1 when it is unknown
+        inline int node_of(const void* address)
+        {
+#if defined(__linux__)
+            int node = -1;
+            if (::syscall(SYS_get_mempolicy, &node, nullptr, 0, address, MPOL_F_NODE | MPOL_F_ADDR) == 0)
+                return node;
+            return -1;
+#else
+            return address ? 0 : -1;
+#endif
+        }
+
+        // whole pages preferring one node - upstream of per node pools, alignment up to page size
+        class node_resource : public std::pmr::memory_resource
+        {
+            int node;
+
+        public:
+            explicit node_resource(int node) : node{node}{}
+
+        private:
+            void* do_allocate(std::size_t bytes, std::size_t alignment) override
+            {
+#if defined(__linux__)
+                static const auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+                if (alignment > page)
+                    throw std::bad_alloc{};
+                auto storage = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (storage == MAP_FAILED)
+                    throw std::bad_alloc{};
+                unsigned long mask[16] = {};
+                mask[node / 64] = 1ul << (node % 64);
+                ::syscall(SYS_mbind, storage, bytes, MPOL_PREFERRED, mask, sizeof(mask) * 8, 0);    // placement is a hint
+                return storage;
+#else
+                return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+#endif
+            }
+
+            void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override
+            {
+#if defined(__linux__)
+                ::munmap(p, bytes);
+#else
+                std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+#endif
+            }
+
+            bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+            {
+                return this == &other;
+            }
+        };
+
+        // process wide thread safe resource allocating from node
+        inline std::pmr::memory_resource& resource(int node)
+        {
+            struct node_pool
+            {
+                node_resource                        pages;
+                std::pmr::synchronized_pool_resource pool{&pages};
+
+                explicit node_pool(int node) : pages{node}{}
+            };
+
+            static const std::vector<std::unique_ptr<node_pool>> pools = []
+            {
+                std::vector<std::unique_ptr<node_pool>> nodes;
+                for (auto node = 0; node < node_count(); ++node)
+                    nodes.emplace_back(new node_pool(node));
+                return nodes;
+            }();
+            if (node < 0 || node >= int(pools.size()))
+                throw std::invalid_argument("no such memory node");
+            return pools[node]->pool;
+        }
+    }
+
+    // node a NUMA placed clone is allocated from
+    class numa_placement
+    {
+        enum class kind { caller, source, node };
+
+        kind placement;
+        int  explicit_node;
+
+        numa_placement(kind placement, int node) : placement{placement}, explicit_node{node}{}
+
+    public:
+        static numa_placement local_to_caller()
+        {
+            return {kind::caller, 0};
+        }
+
+        static numa_placement local_to_source()
+        {
+            return {kind::source, 0};
+        }
+
+        static numa_placement on_node(int node)
+        {
+            return {kind::node, node};
+        }
+
+        int node(const void* source) const
+        {
+            switch (placement)
+            {
+                case kind::caller:
+                    return numa::current_node();
+                case kind::source:
+                {
+                    auto node = numa::node_of(source);
+                    return node < 0 ? numa::current_node() : node;
+                }
+                default:
+                    return explicit_node;
+            }
+        }
+    };
+
+    // clone allocated from numa::resource of node chosen by placement
+    template<typename T>
+    resource_ptr<T> clone(const T& object, numa_placement placement)
+    {
+        return clone(object, numa::resource(placement.node(dynamic_cast<const void*>(&object))));
+    }
+
+    template<typename T>
+    auto clone(T* object, numa_placement placement) -> decltype(clone(*object, placement))
+    {
+        return clone(*object, placement);
+    }
+
+    // clones object on executor - executor(task) has to run task once, object has to outlive returned future
+    template<typename T, typename Executor>
+    auto clone_async(const T& object, Executor&& executor) -> std::future<decltype(clone(object))>
+    {
+        using result_type = decltype(clone(object));
+        auto task   = std::make_shared<std::packaged_task<result_type()>>([&object] { return clone(object); });
+        auto result = task->get_future();
+        std::forward<Executor>(executor)([task] { (*task)(); });
+        return result;
+    }
+
+    // clones object on new thread
+    template<typename T>
+    auto clone_async(const T& object) -> std::future<decltype(clone(object))>
+    {
+        return std::async(std::launch::async, [&object] { return clone(object); });
+    }
+
+    template<typename T, typename... Executor>
+    auto clone_async(T* object, Executor&&... executor) -> decltype(clone_async(*object, std::forward<Executor>(executor)...))
+    {
+        return clone_async(*object, std::forward<Executor>(executor)...);
+    }
+
+    // clone bump-allocated from arena - lives until arena.reset(), final trivially_droppable types are not destroyed
+    template<typename T>
+    arena_ptr<T> clone(const T& object, generation_arena& arena)
+    {
+        using base_type = typename T::base_type;
+        static_assert(std::is_base_of<base_type, T>::value, "T object has to derived from T::base_type");
+        if constexpr (std::is_final<T>::value)
+        {
+            auto ptr = ::new (arena.allocate(sizeof(T), alignof(T))) T(object);
+            if constexpr (!trivially_droppable<T>::value)
+                arena.destroy_on_reset(ptr);
+            return arena_ptr<T>(ptr, arena);
+        }
+        else
+        {
+            auto& base    = static_cast<const base_type&>(object);
+            auto  size    = size_of(base);
+            auto  storage = arena.allocate(size, align_of(base));
+            base_type* ptr = clone_into(base, storage, size).release();
+            arena.destroy_on_reset(ptr);
+            return arena_ptr<T>(static_cast<T*>(ptr), arena);
+        }
+    }
+
+    template<typename T>
+    auto clone(T* object, generation_arena& arena) -> decltype(clone(*object, arena))
+    {
+        return clone(*object, arena);
+    }
+
+    // copyable owner of polymorphic T - objects up to Capacity bytes are kept inline,
+    // bigger ones or adopted unique_ptr<T> live on heap and are copied with object::clone
+    template<typename T, std::size_t Capacity = 32>
+    class poly_value
+    {
+        struct operations
+        {
+            T*   (*copy)(const void* from, void* to);
+            T*   (*move)(void* from, void* to);
+            void (*destroy)(void* object);
+        };
+
+        template<typename U>
+        static const operations* inline_operations()
+        {
+            static const operations ops = {
+                [](const void* from, void* to) -> T* { return ::new (to) U(*static_cast<const U*>(from)); },
+                [](void* from, void* to) -> T* { return ::new (to) U(std::move(*static_cast<U*>(from))); },
+                [](void* object) { static_cast<U*>(object)->~U(); }
+            };
+            return &ops;
+        }
+
+        template<typename U>
+        using fits_inline = std::integral_constant<bool, sizeof(U) <= Capacity
+                                                         && alignof(U) <= alignof(std::max_align_t)
+                                                         && std::is_nothrow_move_constructible<U>::value>;
+
+        alignas(std::max_align_t) unsigned char buffer[Capacity];
+        T*                object = nullptr;
+        const operations* ops    = nullptr;   // null when object is on heap
+
+    public:
+        template<typename U, typename = typename std::enable_if<std::is_base_of<T, U>::value>::type>
+        poly_value(U value)
+        {
+            if constexpr (fits_inline<U>::value)
+            {
+                ops    = inline_operations<U>();
+                object = ::new (buffer) U(std::move(value));
+            }
+            else
+                object = new U(std::move(value));
+        }
+
+        explicit poly_value(std::unique_ptr<T> value) : object{value.release()}{}
+
+        poly_value(const poly_value& other)
+        {
+            if (other.ops)
+            {
+                object = other.ops->copy(other.buffer, buffer);
+                ops    = other.ops;
+            }
+            else if (other.object)
+                object = object::clone(*other.object).release();
+        }
+
+        poly_value(poly_value&& other) noexcept
+        {
+            take(other);
+        }
+
+        poly_value& operator=(poly_value other) noexcept
+        {
+            reset();
+            take(other);
+            return *this;
+        }
+
+        ~poly_value()
+        {
+            reset();
+        }
+
+        T& operator*() const
+        {
+            return *object;
+        }
+
+        T* operator->() const
+        {
+            return object;
+        }
+
+        T* get() const
+        {
+            return object;
+        }
+
+        explicit operator bool() const
+        {
+            return object != nullptr;
+        }
+
+        bool is_inline() const
+        {
+            return ops != nullptr;
+        }
+
+    private:
+        void take(poly_value& other) noexcept
+        {
+            if (other.ops)
+            {
+                object = other.ops->move(other.buffer, buffer);
+                ops    = other.ops;
+                other.reset();
+            }
+            else
+                std::swap(object, other.object);
+        }
+
+        void reset() noexcept
+        {
+            if (ops)
+                ops->destroy(buffer);
+            else
+                delete object;
+            object = nullptr;
+            ops    = nullptr;
+        }
+    };
+
+    // shares object between copies until first non-const access which detaches own copy with object::clone
+    template<typename T>
+    class cow_ptr
+    {
+        std::shared_ptr<T> object;
+
+    public:
+        template<typename U, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+        explicit cow_ptr(std::shared_ptr<U> object) : object{std::move(object)}{}
+
+        template<typename U, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+        explicit cow_ptr(std::unique_ptr<U> object) : object{std::move(object)}{}
+
+        const T& operator*() const
+        {
+            return *object;
+        }
+
+        const T* operator->() const
+        {
+            return object.get();
+        }
+
+        const T* get() const
+        {
+            return object.get();
+        }
+
+        T& operator*()
+        {
+            return *detach();
+        }
+
+        T* operator->()
+        {
+            return detach();
+        }
+
+        T* get()
+        {
+            return detach();
+        }
+
+        // not synchronized - copies shared between threads need external locking
+        bool unique() const
+        {
+            return object.use_count() == 1;
+        }
+
+    private:
+        T* detach()
+        {
+            if (object && !unique())
+                object = object::clone(*object);
+            return object.get();
+        }
+    };
+
+    namespace detail
+    {
+        // node of intrusive list of lazy clones waiting for their source
+        struct lazy_link
+        {
+            lazy_link* prev = nullptr;
+            lazy_link* next = nullptr;
+            lazy_link** head = nullptr;
+
+            virtual void materialize() = 0;
+            virtual void abandon()     = 0;
+
+            void link(lazy_link*& list)
+            {
+                head = &list;
+                next = list;
+                if (next)
+                    next->prev = this;
+                list = this;
+            }
+
+            void unlink()
+            {
+                if (!head)
+                    return;
+                if (prev)
+                    prev->next = next;
+                else
+                    *head = next;
+                if (next)
+                    next->prev = prev;
+                prev = next = nullptr;
+                head = nullptr;
+            }
+
+        protected:
+            ~lazy_link() = default;
+        };
+    }
+
+    template<typename T>
+    class lazy_clone;
+
+    // inherited by types which report mutation - modify() has to be called before object changes,
+    // it materializes every pending lazy_clone of object and gives it new version;
+    // destructor of derived type calls materialize_lazy_clones() while object can still be cloned.
+    // versions are unique across objects - only unmodified copies share version of their original
+    class versioned
+    {
+        mutable detail::lazy_link* pending = nullptr;
+        std::uint64_t              stamp   = next_stamp();
+
+        static std::uint64_t next_stamp()
+        {
+            static std::atomic<std::uint64_t> stamps{0};
+            return stamps.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        template<typename T>
+        friend class lazy_clone;
+
+    public:
+        std::uint64_t version() const
+        {
+            return stamp;
+        }
+
+    protected:
+        versioned() = default;
+
+        versioned(const versioned& other) : stamp{other.stamp}{}
+
+        versioned(versioned&& other) : stamp{other.stamp}
+        {
+            other.modify();
+        }
+
+        versioned& operator=(const versioned&)
+        {
+            modify();
+            return *this;
+        }
+
+        versioned& operator=(versioned&& other)
+        {
+            modify();
+            other.modify();
+            return *this;
+        }
+
+        ~versioned()
+        {
+            while (pending)
+                pending->abandon();
+        }
+
+        void modify()
+        {
+            materialize_lazy_clones();
+            stamp = next_stamp();
+        }
+
+        void materialize_lazy_clones() const
+        {
+            while (pending)
+                pending->materialize();
+        }
+    };
+
+    // clone of source made on first dereference or right before source changes or dies - not synchronized
+    template<typename T>
+    class lazy_clone : detail::lazy_link
+    {
+        const T*              source;
+        std::uint64_t         captured;
+        mutable std::unique_ptr<T> copy;
+
+    public:
+        explicit lazy_clone(const T& source) : source{&source}, captured{tracker(source).version()}
+        {
+            link(tracker(source).pending);
+        }
+
+        lazy_clone(lazy_clone&& other) : source{other.source}, captured{other.captured}, copy{std::move(other.copy)}
+        {
+            if (other.head)
+            {
+                other.unlink();
+                link(tracker(*source).pending);
+            }
+        }
+
+        lazy_clone(const lazy_clone&) = delete;
+        lazy_clone& operator=(const lazy_clone&) = delete;
+
+        ~lazy_clone()
+        {
+            unlink();
+        }
+
+        T& operator*() const
+        {
+            return *get();
+        }
+
+        T* operator->() const
+        {
+            return get();
+        }
+
+        T* get() const
+        {
+            const_cast<lazy_clone*>(this)->materialize();
+            if (!copy)
+                throw std::logic_error("source of lazy clone was destroyed before it was cloned");
+            return copy.get();
+        }
+
+        bool materialized() const
+        {
+            return copy != nullptr;
+        }
+
+        // version of source which clone represents
+        std::uint64_t version() const
+        {
+            return captured;
+        }
+
+    private:
+        static const versioned& tracker(const T& source)
+        {
+            if constexpr (std::is_base_of<versioned, T>::value)
+                return source;
+            else
+            {
+                auto tracked = dynamic_cast<const versioned*>(&source);
+                if (!tracked)
+                    throw std::invalid_argument("source of lazy clone has to be versioned");
+                return *tracked;
+            }
+        }
+
+        void materialize() override
+        {
+            if (!copy && source)
+                copy = object::clone(*source);
+            unlink();
+        }
+
+        void abandon() override
+        {
+            source = nullptr;
+            unlink();
+        }
+    };
+
+    template<typename T>
+    class incremental_snapshot;
+
+    template<typename T, typename ForwardIt>
+    incremental_snapshot<T> clone_incremental(const incremental_snapshot<T>& previous, ForwardIt first, ForwardIt last);
+
+    // clones of range of objects - clone of unchanged versioned object is shared with previous snapshot
+    template<typename T>
+    class incremental_snapshot
+    {
+        struct entry
+        {
+            const void*              source;
+            std::uint64_t            version;
+            bool                     tracked;
+            std::shared_ptr<const T> clone;
+        };
+
+        std::vector<entry> entries;
+        std::size_t        fresh = 0;
+
+        template<typename U, typename ForwardIt>
+        friend incremental_snapshot<U> clone_incremental(const incremental_snapshot<U>&, ForwardIt, ForwardIt);
+
+    public:
+        const T& operator[](std::size_t index) const
+        {
+            return *entries[index].clone;
+        }
+
+        std::shared_ptr<const T> share(std::size_t index) const
+        {
+            return entries[index].clone;
+        }
+
+        std::size_t size() const
+        {
+            return entries.size();
+        }
+
+        // objects cloned to build this snapshot, the rest is shared with previous one
+        std::size_t cloned() const
+        {
+            return fresh;
+        }
+    };
+
+    // snapshot of objects pointed by [first, last) which clones only objects not versioned or changed since previous
+    template<typename T, typename ForwardIt>
+    incremental_snapshot<T> clone_incremental(const incremental_snapshot<T>& previous, ForwardIt first, ForwardIt last)
+    {
+        std::unordered_map<const void*, std::size_t> moved;    // filled only when objects changed position
+        auto find = [&](std::size_t position, const void* source) -> const typename incremental_snapshot<T>::entry*
+        {
+            auto& entries = previous.entries;
+            if (position < entries.size() && entries[position].source == source)
+                return &entries[position];
+            if (moved.empty())
+                for (std::size_t i = 0; i < entries.size(); ++i)
+                    moved.emplace(entries[i].source, i);
+            auto found = moved.find(source);
+            return found != moved.end() ? &entries[found->second] : nullptr;
+        };
+
+        incremental_snapshot<T> next;
+        for (std::size_t position = 0; first != last; ++first, ++position)
+        {
+            const T& object = **first;
+            auto tracked = dynamic_cast<const versioned*>(&object);
+            auto source  = static_cast<const void*>(&object);
+            auto version = tracked ? tracked->version() : 0;
+            auto old     = find(position, source);
+            if (tracked && old && old->tracked && old->version == version)
+                next.entries.push_back(*old);
+            else
+            {
+                next.entries.push_back({source, version, tracked != nullptr, clone(object)});
+                ++next.fresh;
+            }
+        }
+        return next;
+    }
+
+    template<typename T, typename Range>
+    auto clone_incremental(const incremental_snapshot<T>& previous, const Range& current) -> decltype(clone_incremental(previous, std::begin(current), std::end(current)))
+    {
+        return clone_incremental(previous, std::begin(current), std::end(current));
+    }
+
+    // reference count embedded in object - inherited next to cloneable by root of hierarchy
+    // so object::clone_shared needs no separate control block
+    class ref_counted
+    {
+        mutable std::atomic<long> references{0};
+
+        template<typename T>
+        friend class intrusive_ptr;
+
+    protected:
+        ref_counted() = default;
+        ref_counted(const ref_counted&){}
+        ref_counted& operator=(const ref_counted&)
+        {
+            return *this;
+        }
+        ~ref_counted() = default;
+    };
+
+    template<typename T>
+    struct shared_cloneable : cloneable<T>, ref_counted
+    {
+    };
+
+    template<typename T>
+    class intrusive_ptr
+    {
+        T* object = nullptr;
+
+        template<typename U>
+        friend class intrusive_ptr;
+
+    public:
+        intrusive_ptr() = default;
+
+        explicit intrusive_ptr(T* object) : object{object}
+        {
+            retain();
+        }
+
+        intrusive_ptr(const intrusive_ptr& other) : intrusive_ptr(other.object){}
+
+        template<typename U, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+        intrusive_ptr(const intrusive_ptr<U>& other) : intrusive_ptr(other.object){}
+
+        intrusive_ptr(intrusive_ptr&& other) noexcept : object{other.object}
+        {
+            other.object = nullptr;
+        }
+
+        intrusive_ptr& operator=(intrusive_ptr other) noexcept
+        {
+            std::swap(object, other.object);
+            return *this;
+        }
+
+        ~intrusive_ptr()
+        {
+            release();
+        }
+
+        T& operator*() const
+        {
+            return *object;
+        }
+
+        T* operator->() const
+        {
+            return object;
+        }
+
+        T* get() const
+        {
+            return object;
+        }
+
+        explicit operator bool() const
+        {
+            return object != nullptr;
+        }
+
+        long use_count() const
+        {
+            return object ? counter().load(std::memory_order_relaxed) : 0;
+        }
+
+    private:
+        std::atomic<long>& counter() const
+        {
+            return static_cast<const ref_counted&>(*object).references;
+        }
+
+        void retain()
+        {
+            if (object)
+                counter().fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void release()
+        {
+            if (object && counter().fetch_sub(1, std::memory_order_acq_rel) == 1)
+                delete object;
+        }
+    };
+
+    // one allocation - count lives inside cloned object
+    template<typename T>
+    intrusive_ptr<T> clone_shared(const T& object)
+    {
+        static_assert(std::is_base_of<ref_counted, T>::value, "T object has to derived from object::ref_counted");
+        return intrusive_ptr<T>(clone(object).release());
+    }
+
+    template<typename T>
+    auto clone_shared(T* object) -> decltype(clone_shared(*object))
+    {
+        return clone_shared(*object);
+    }
+
+    class clone_context;
+
+    // inherited next to cloneable by types which point to other objects of graph -
+    // relink() is called on fresh shallow copy and replaces every pointer with context.clone(*pointee)
+    class composite
+    {
+    public:
+        virtual ~composite() = default;
+
+    protected:
+        virtual void relink(clone_context& context) = 0;
+
+        friend class clone_context;
+    };
+
+    // clones of one deep_clone graph - every source object is cloned once and all clones
+    // live in one arena, they are destroyed together with context
+    class clone_context
+    {
+        using destroy_function = void (*)(void*);
+
+        std::pmr::monotonic_buffer_resource arena;
+        std::unordered_map<const void*, void*> clones;
+        std::vector<std::pair<void*, destroy_function>> destroy;
+
+    public:
+        explicit clone_context(std::pmr::memory_resource& upstream = *std::pmr::get_default_resource()) : arena{&upstream}{}
+
+        clone_context(const clone_context&) = delete;
+        clone_context& operator=(const clone_context&) = delete;
+
+        ~clone_context()
+        {
+            for (auto it = destroy.rbegin(); it != destroy.rend(); ++it)
+                it->second(it->first);
+        }
+
+        // clone of source owned by context - source reached again maps to the same clone
+        template<typename T>
+        T& clone(const T& source)
+        {
+            using base_type = typename T::base_type;
+            static_assert(std::is_base_of<base_type, T>::value, "T object has to derived from T::base_type");
+            auto& base = static_cast<const base_type&>(source);
+            auto  key  = dynamic_cast<const void*>(&source);
+            if (auto found = clones.find(key); found != clones.end())
+                return static_cast<T&>(*static_cast<base_type*>(found->second));
+
+            auto size    = object::size_of(base);
+            auto storage = arena.allocate(size, object::align_of(base));
+            base_type* copy = object::clone_into(base, storage, size).release();
+            destroy.emplace_back(copy, [](void* object) { static_cast<base_type*>(object)->~base_type(); });
+            clones.emplace(key, copy);     // registered before relink so cycles end here
+            if (auto node = dynamic_cast<composite*>(copy))
+                node->relink(*this);
+            return static_cast<T&>(*copy);
+        }
+
+        std::size_t size() const
+        {
+            return clones.size();
+        }
+    };
+
+    // clones graph reachable from root preserving sharing and cycles - clones are owned by context
+    template<typename T>
+    T* deep_clone(const T& root, clone_context& context)
+    {
+        return &context.clone(root);
+    }
+
+    template<typename T>
+    auto deep_clone(T* root, clone_context& context) -> decltype(deep_clone(*root, context))
+    {
+        return deep_clone(*root, context);
+    }
+
+    // how T is written to snapshot - specialization provides trivially copyable payload_type,
+    // static payload_type save(const T&) and static T load(const payload_type&)
+    template<typename T>
+    struct snapshot_traits;
+
+    // types of Base hierarchy which can be written to snapshot - filled during static initialization
+    template<typename Base>
+    class registry
+    {
+    public:
+        struct entry
+        {
+            std::uint32_t         id;
+            std::type_index       type;
+            std::uint32_t         size;   // payload bytes
+            void                  (*save)(const Base& object, void* payload);
+            std::unique_ptr<Base> (*load)(const void* payload);
+        };
+
+        static registry& instance()
+        {
+            static registry types;
+            return types;
+        }
+
+        template<typename T>
+        void add(std::uint32_t id)
+        {
+            using payload_type = typename snapshot_traits<T>::payload_type;
+            static_assert(std::is_base_of<Base, T>::value, "T object has to derived from Base");
+            static_assert(std::is_trivially_copyable<payload_type>::value, "snapshot payload has to be trivially copyable");
+
+            if (by_id.count(id) || by_type.count(typeid(T)))
+                throw std::invalid_argument("type or id already registered");
+
+            by_id.emplace(id, entry{id, typeid(T), sizeof(payload_type),
+                [](const Base& object, void* payload)
+                {
+                    auto value = snapshot_traits<T>::save(static_cast<const T&>(object));
+                    std::memcpy(payload, &value, sizeof(value));
+                },
+                [](const void* payload) -> std::unique_ptr<Base>
+                {
+                    payload_type value;
+                    std::memcpy(&value, payload, sizeof(value));
+                    return std::unique_ptr<Base>(new T(snapshot_traits<T>::load(value)));
+                }});
+            by_type.emplace(typeid(T), id);
+        }
+
+        const entry* find(std::uint32_t id) const
+        {
+            auto it = by_id.find(id);
+            return it != by_id.end() ? &it->second : nullptr;
+        }
+
+        const entry* find(const std::type_info& type) const
+        {
+            auto it = by_type.find(type);
+            return it != by_type.end() ? find(it->second) : nullptr;
+        }
+
+    private:
+        std::unordered_map<std::uint32_t, entry>         by_id;
+        std::unordered_map<std::type_index, std::uint32_t> by_type;
+    };
+
+    template<typename Base, typename T>
+    struct registration
+    {
+        explicit registration(std::uint32_t id)
+        {
+            registry<Base>::instance().template add<T>(id);
+        }
+    };
+
+    // snapshot layout: header followed by count records, each record is followed by
+    // its payload padded to snapshot_alignment so buffer can be used directly after mmap
+    constexpr std::uint32_t snapshot_magic     = 0x534a424f;   // "OBJS"
+    constexpr std::size_t   snapshot_alignment = 8;
+
+    struct snapshot_header
+    {
+        std::uint32_t magic;
+        std::uint32_t count;
+    };
+
+    struct snapshot_record
+    {
+        std::uint32_t type;
+        std::uint32_t size;
+    };
+
+    namespace detail
+    {
+        constexpr std::size_t padded(std::size_t size)
+        {
+            return (size + snapshot_alignment - 1) / snapshot_alignment * snapshot_alignment;
+        }
+    }
+
+    // writes objects pointed by [first, last) to one contiguous buffer - their types have to be registered
+    template<typename ForwardIt>
+    std::vector<unsigned char> snapshot(ForwardIt first, ForwardIt last)
+    {
+        using object_type = typename std::remove_const<typename std::remove_reference<decltype(**first)>::type>::type;
+        using base_type   = typename object_type::base_type;
+        auto& types = registry<base_type>::instance();
+
+        std::vector<const typename registry<base_type>::entry*> entries;
+        auto size = sizeof(snapshot_header);
+        for (auto it = first; it != last; ++it)
+        {
+            auto entry = types.find(typeid(**it));
+            if (!entry)
+                throw std::invalid_argument("type of object is not registered");
+            entries.push_back(entry);
+            size += sizeof(snapshot_record) + detail::padded(entry->size);
+        }
+
+        std::vector<unsigned char> buffer(size);
+        auto header = snapshot_header{snapshot_magic, static_cast<std::uint32_t>(entries.size())};
+        std::memcpy(buffer.data(), &header, sizeof(header));
+
+        auto position = sizeof(snapshot_header);
+        for (auto entry : entries)
+        {
+            auto record = snapshot_record{entry->id, entry->size};
+            std::memcpy(&buffer[position], &record, sizeof(record));
+            entry->save(**first++, &buffer[position + sizeof(record)]);
+            position += sizeof(record) + detail::padded(entry->size);
+        }
+        return buffer;
+    }
+
+    // calls visit(record, payload) for every record of snapshot
+    template<typename Visitor>
+    void for_each_record(const void* data, std::size_t size, Visitor visit)
+    {
+        auto bytes = static_cast<const unsigned char*>(data);
+        snapshot_header header;
+        if (size < sizeof(header))
+            throw std::invalid_argument("snapshot is truncated");
+        std::memcpy(&header, bytes, sizeof(header));
+        if (header.magic != snapshot_magic)
+            throw std::invalid_argument("buffer is not a snapshot");
+
+        auto position = sizeof(header);
+        for (auto i = 0u; i < header.count; ++i)
+        {
+            snapshot_record record;
+            if (size - position < sizeof(record))
+                throw std::invalid_argument("snapshot is truncated");
+            std::memcpy(&record, bytes + position, sizeof(record));
+            position += sizeof(record);
+            if (size - position < detail::padded(record.size))
+                throw std::invalid_argument("snapshot is truncated");
+            visit(record, bytes + position);
+            position += detail::padded(record.size);
+        }
+    }
+
+    template<typename Base>
+    std::vector<std::unique_ptr<Base>> restore(const void* data, std::size_t size)
+    {
+        auto& types = registry<Base>::instance();
+        std::vector<std::unique_ptr<Base>> objects;
+        for_each_record(data, size, [&](const snapshot_record& record, const void* payload)
+        {
+            auto entry = types.find(record.type);
+            if (!entry || entry->size != record.size)
+                throw std::invalid_argument("snapshot contains unknown type");
+            objects.push_back(entry->load(payload));
+        });
+        return objects;
+    }
+
+    template<typename Base>
+    std::vector<std::unique_ptr<Base>> restore(const std::vector<unsigned char>& buffer)
+    {
+        return restore<Base>(buffer.data(), buffer.size());
+    }
+
+    // 32-bit reference to object of compact_slabs - high tag_bits select slab of one type, the rest is index in it
+    class compact_handle
+    {
+    public:
+        static constexpr unsigned      tag_bits   = 4;
+        static constexpr unsigned      index_bits = 32 - tag_bits;
+        static constexpr std::uint32_t max_tag    = (std::uint32_t{1} << tag_bits) - 1;
+        static constexpr std::uint32_t max_index  = (std::uint32_t{1} << index_bits) - 1;
+
+        compact_handle() = default;
+        compact_handle(std::uint32_t tag, std::uint32_t index) : bits{tag << index_bits | index}{}
+
+        std::uint32_t tag() const
+        {
+            return bits >> index_bits;
+        }
+
+        std::uint32_t index() const
+        {
+            return bits & max_index;
+        }
+
+        bool operator==(const compact_handle& other) const
+        {
+            return bits == other.bits;
+        }
+
+        bool operator!=(const compact_handle& other) const
+        {
+            return !(*this == other);
+        }
+
+    private:
+        std::uint32_t bits = 0;
+    };
+
+    // clones of Base hierarchy kept as snapshot payloads packed in one slab per type -
+    // no vptr and no allocation per object, types have to be registered in registry<Base>
+    template<typename Base>
+    class compact_slabs
+    {
+        using entry = typename registry<Base>::entry;
+
+        struct slab
+        {
+            const entry*               type;
+            std::uint32_t              count = 0;
+            std::vector<unsigned char> payloads;
+        };
+
+        std::vector<slab> slabs;
+
+    public:
+        compact_handle add(const Base& object)
+        {
+            auto type = registry<Base>::instance().find(typeid(object));
+            if (!type)
+                throw std::invalid_argument("type is not registered");
+            auto  tag  = tag_of(*type);
+            auto& into = slabs[tag];
+            if (into.count > compact_handle::max_index)
+                throw std::length_error("slab is full");
+            into.payloads.resize(into.payloads.size() + type->size);
+            type->save(object, into.payloads.data() + std::size_t{into.count} * type->size);
+            return compact_handle{tag, into.count++};
+        }
+
+        // registry id of type stored under tag
+        std::uint32_t type(std::uint32_t tag) const
+        {
+            return slabs[tag].type->id;
+        }
+
+        std::uint32_t tags() const
+        {
+            return static_cast<std::uint32_t>(slabs.size());
+        }
+
+        const void* payload(compact_handle handle) const
+        {
+            auto& from = slabs[handle.tag()];
+            return from.payloads.data() + std::size_t{handle.index()} * from.type->size;
+        }
+
+        std::unique_ptr<Base> restore(compact_handle handle) const
+        {
+            return slabs[handle.tag()].type->load(payload(handle));
+        }
+
+    private:
+        std::uint32_t tag_of(const entry& type)
+        {
+            for (std::uint32_t tag = 0; tag < slabs.size(); ++tag)
+                if (slabs[tag].type == &type)
+                    return tag;
+            if (slabs.size() > compact_handle::max_tag)
+                throw std::length_error("too many types for compact_handle");
+            slabs.push_back(slab{&type});
+            return tags() - 1;
+        }
+    };
+
+    template<typename T, typename Base>
+    compact_handle clone(const T& object, compact_slabs<Base>& slabs)
+    {
+        return slabs.add(object);
+    }
+
+    template<typename T, typename Base>
+    compact_handle clone(T* object, compact_slabs<Base>& slabs)
+    {
+        return clone(*object, slabs);
+    }
+
+    // pointer relative to its own address - stays valid when memory holding it and target is mapped at another address
+    template<typename T>
+    class offset_ptr
+    {
+        static constexpr std::ptrdiff_t null = 1;     // would point into offset_ptr itself
+
+        std::ptrdiff_t offset = null;
+
+    public:
+        offset_ptr() = default;
+
+        offset_ptr(T* target)
+        {
+            *this = target;
+        }
+
+        offset_ptr(const offset_ptr& other) : offset_ptr(other.get()){}
+
+        offset_ptr& operator=(const offset_ptr& other)
+        {
+            return *this = other.get();
+        }
+
+        offset_ptr& operator=(T* target)
+        {
+            offset = target ? static_cast<std::ptrdiff_t>(reinterpret_cast<std::uintptr_t>(target) - reinterpret_cast<std::uintptr_t>(this)) : null;
+            return *this;
+        }
+
+        T* get() const
+        {
+            return offset == null ? nullptr : reinterpret_cast<T*>(reinterpret_cast<std::uintptr_t>(this) + offset);
+        }
+
+        T& operator*() const
+        {
+            return *get();
+        }
+
+        T* operator->() const
+        {
+            return get();
+        }
+
+        explicit operator bool() const
+        {
+            return offset != null;
+        }
+    };
+
+#if defined(__unix__)
+    // named POSIX shared memory mapped into this process - creator maps it writable, other processes read only.
+    // snapshot payloads in it can be read by any process, objects placed with clone_into only by processes
+    // forked from the same binary as they hold vtable pointers
+    class shared_segment
+    {
+        std::string name;
+        void*       mapping = nullptr;
+        std::size_t bytes   = 0;
+
+        shared_segment(const std::string& name, std::size_t size, bool create) : name{name}
+        {
+            auto descriptor = ::shm_open(name.c_str(), create ? O_CREAT | O_EXCL | O_RDWR : O_RDONLY, 0600);
+            if (descriptor < 0)
+                throw std::system_error(errno, std::generic_category(), "cannot open shared memory " + name);
+
+            struct stat status{};
+            if (create ? ::ftruncate(descriptor, static_cast<off_t>(size)) != 0 : ::fstat(descriptor, &status) != 0)
+            {
+                auto error = errno;
+                ::close(descriptor);
+                if (create)
+                    ::shm_unlink(name.c_str());
+                throw std::system_error(error, std::generic_category(), "cannot size shared memory " + name);
+            }
+            bytes   = create ? size : static_cast<std::size_t>(status.st_size);
+            mapping = ::mmap(nullptr, bytes, create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, descriptor, 0);
+            auto error = errno;
+            ::close(descriptor);
+            if (mapping == MAP_FAILED)
+            {
+                mapping = nullptr;
+                if (create)
+                    ::shm_unlink(name.c_str());
+                throw std::system_error(error, std::generic_category(), "cannot map shared memory " + name);
+            }
+        }
+
+    public:
+        // name has form "/name" and must not exist yet
+        static shared_segment create(const std::string& name, std::size_t size)
+        {
+            if (!size)
+                throw std::invalid_argument("shared memory segment cannot be empty");
+            return shared_segment{name, size, true};
+        }
+
+        static shared_segment open(const std::string& name)
+        {
+            return shared_segment{name, 0, false};
+        }
+
+        // mappings stay valid, new open() calls fail
+        static void remove(const std::string& name)
+        {
+            ::shm_unlink(name.c_str());
+        }
+
+        shared_segment(shared_segment&& other) noexcept : name{std::move(other.name)}, mapping{other.mapping}, bytes{other.bytes}
+        {
+            other.mapping = nullptr;
+        }
+
+        shared_segment(const shared_segment&) = delete;
+        shared_segment& operator=(const shared_segment&) = delete;
+
+        ~shared_segment()
+        {
+            if (mapping)
+                ::munmap(mapping, bytes);
+        }
+
+        void* data() const
+        {
+            return mapping;
+        }
+
+        std::size_t size() const
+        {
+            return bytes;
+        }
+    };
+
+    // snapshot of objects pointed by [first, last) written to new segment - one copy for all processes mapping it
+    template<typename ForwardIt>
+    shared_segment publish_snapshot(const std::string& name, ForwardIt first, ForwardIt last)
+    {
+        auto buffer  = snapshot(first, last);
+        auto segment = shared_segment::create(name, buffer.size());
+        std::memcpy(segment.data(), buffer.data(), buffer.size());
+        return segment;
+    }
+#endif
+}
+
+struct Figure : object::cloneable<Figure>
+{
+    virtual double  area()  const = 0;
+};
+
+struct Square : Figure
+{
+    double a = 0;
+
+    Square() = default;
+    Square(double a) : a{a}{}
+
+    double  area()  const override
+    {
+        return area_of(a);
+    }
+
+    static double area_of(double a)
+    {
+        return a * a;
+    }
+
+protected:
+    Square* clone() const override     // return type is Square* instead of Figure* (Covariant Return Type)
+    {
+        return new Square(*this);
+    }
+
+    Square* move_clone() override
+    {
+        return new Square(std::move(*this));
+    }
+
+    std::size_t size_of() const override
+    {
+        return sizeof(Square);
+    }
+
+    std::size_t align_of() const override
+    {
+        return alignof(Square);
+    }
+
+    Square* clone_into(void* storage) const override
+    {
+        return new (storage) Square(*this);
+    }
+};
+
+template<typename Policy>
+struct PooledSquare : object::cloneable_impl<PooledSquare<Policy>, Square>, object::pooled<PooledSquare<Policy>, Policy>
+{
+    using object::cloneable_impl<PooledSquare<Policy>, Square>::cloneable_impl;
+};
+
+struct FinalSquare final : object::cloneable_impl<FinalSquare, Square>
+{
+    static inline int virtual_clones = 0;
+
+    using cloneable_impl::cloneable_impl;
+
+protected:
+    FinalSquare* clone() const override
+    {
+        ++virtual_clones;
+        return new FinalSquare(*this);
+    }
+};
+
+namespace object
+{
+    template<>
+    struct snapshot_traits<Square>
+    {
+        using payload_type = double;
+
+        static payload_type save(const Square& square)
+        {
+            return square.a;
+        }
+
+        static Square load(const payload_type& a)
+        {
+            return Square{a};
+        }
+
+        static double area(const payload_type& a)
+        {
+            return Square::area_of(a);
+        }
+    };
+}
+
+inline const object::registration<Figure, Square> square_registration{1};
+
+// read-only figures of snapshot - area() is dispatched on stored type id without restoring objects
+class FigureView
+{
+public:
+    using area_function = double (*)(const void* payload);
+
+    struct figure
+    {
+        std::uint32_t type;
+        const void*   payload;
+        area_function area_of;
+
+        double area() const
+        {
+            return area_of(payload);
+        }
+    };
+
+    class iterator
+    {
+        const FigureView*     view      = nullptr;
+        const unsigned char*  position  = nullptr;
+        std::uint32_t         remaining = 0;
+        mutable std::uint32_t last_type = 0;        // area function of last dereferenced type
+        mutable area_function last_area = nullptr;
+
+    public:
+        // figures are decoded on dereference so there is no figure object to refer to
+        using iterator_category = std::input_iterator_tag;
+        using value_type        = figure;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = void;
+        using reference         = figure;
+
+        iterator() = default;
+        iterator(const FigureView* view, const unsigned char* position, std::uint32_t remaining)
+            : view{view}, position{position}, remaining{remaining}{}
+
+        figure operator*() const
+        {
+            auto record = current();
+            if (!last_area || record.type != last_type)    // runs of one type skip lookup
+            {
+                last_type = record.type;
+                last_area = view->find(record.type);      // resolved by view constructor
+            }
+            return figure{record.type, position + sizeof(record), last_area};
+        }
+
+        iterator& operator++()
+        {
+            position += sizeof(object::snapshot_record) + object::detail::padded(current().size);
+            --remaining;
+            return *this;
+        }
+
+        iterator operator++(int)
+        {
+            auto previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(const iterator& other) const
+        {
+            return remaining == other.remaining;
+        }
+
+        bool operator!=(const iterator& other) const
+        {
+            return !(*this == other);
+        }
+
+    private:
+        object::snapshot_record current() const
+        {
+            object::snapshot_record record;
+            std::memcpy(&record, position, sizeof(record));
+            return record;
+        }
+    };
+
+    // buffer is validated and its types resolved once here - buffer has to outlive the view, view its iterators
+    FigureView(const void* data, std::size_t size) : data{static_cast<const unsigned char*>(data)}
+    {
+        object::for_each_record(data, size, [&](const object::snapshot_record& record, const void*)
+        {
+            if (!find(record.type))
+            {
+                auto it = areas().find(record.type);
+                if (it == areas().end())
+                    throw std::invalid_argument("snapshot contains unknown type");
+                functions.push_back(*it);
+            }
+            ++count;
+        });
+    }
+
+    explicit FigureView(const std::vector<unsigned char>& buffer) : FigureView(buffer.data(), buffer.size()){}
+
+    iterator begin() const
+    {
+        return iterator{this, data + sizeof(object::snapshot_header), count};
+    }
+
+    iterator end() const
+    {
+        return iterator{this, nullptr, 0};
+    }
+
+    std::size_t size() const
+    {
+        return count;
+    }
+
+    double total_area() const
+    {
+        auto total = 0.;
+        for (auto figure : *this)
+            total += figure.area();
+        return total;
+    }
+
+    static area_function area_of(std::uint32_t type)
+    {
+        auto it = areas().find(type);
+        if (it == areas().end())
+            throw std::invalid_argument("type has no area function");
+        return it->second;
+    }
+
+    // T has to be registered in object::registry<Figure> and have snapshot_traits<T>::area
+    template<typename T>
+    static void add()
+    {
+        using traits = object::snapshot_traits<T>;
+        auto entry = object::registry<Figure>::instance().find(typeid(T));
+        if (!entry)
+            throw std::invalid_argument("type is not registered");
+        areas()[entry->id] = [](const void* payload)
+        {
+            typename traits::payload_type value;
+            std::memcpy(&value, payload, sizeof(value));
+            return traits::area(value);
+        };
+    }
+
+private:
+    static std::unordered_map<std::uint32_t, area_function>& areas()
+    {
+        static std::unordered_map<std::uint32_t, area_function> functions;
+        return functions;
+    }
+
+    // area function of type met in buffer - snapshots hold few distinct types
+    area_function find(std::uint32_t type) const
+    {
+        for (auto& function : functions)
+            if (function.first == type)
+                return function.second;
+        return nullptr;
+    }
+
+    const unsigned char*                                 data;
+    std::uint32_t                                        count = 0;
+    std::vector<std::pair<std::uint32_t, area_function>> functions;     // types of buffer
+};
+
+inline const bool square_view_registration = (FigureView::add<Square>(), true);
+
+// figures cloned into compact slabs - 4 byte handle plus payload per figure, area() dispatches on handle tag
+class CompactFigures
+{
+    object::compact_slabs<Figure>          slabs;
+    std::vector<object::compact_handle>    handles;
+    std::vector<FigureView::area_function> areas;   // by tag
+
+public:
+    object::compact_handle add(const Figure& figure)
+    {
+        auto handle = object::clone(figure, slabs);
+        if (handle.tag() == areas.size())
+            areas.push_back(FigureView::area_of(slabs.type(handle.tag())));
+        handles.push_back(handle);
+        return handle;
+    }
+
+    double area(object::compact_handle handle) const
+    {
+        return areas[handle.tag()](slabs.payload(handle));
+    }
+
+    double total_area() const
+    {
+        auto total = 0.;
+        for (auto handle : handles)
+            total += area(handle);
+        return total;
+    }
+
+    std::unique_ptr<Figure> restore(object::compact_handle handle) const
+    {
+        return slabs.restore(handle);
+    }
+
+    std::size_t size() const
+    {
+        return handles.size();
+    }
+};
+
+struct Point
+{
+    double x = 0;
+    double y = 0;
+};
+
+// opt-in memoized area() for versioned Derived which implements compute_area() -
+// cache is valid while version() does not change and is copied together with object
+template<typename Derived, typename Base = Figure>
+class CachedArea : public Base
+{
+    static constexpr std::uint64_t none = ~std::uint64_t{0};
+
+    mutable std::atomic<std::uint64_t> cached_version{none};
+    mutable std::atomic<double>        cached_area{0};
+
+public:
+    CachedArea() = default;
+
+    CachedArea(const CachedArea& other)
+        : Base(other), cached_version{other.cached_version.load()}, cached_area{other.cached_area.load()}{}
+
+    CachedArea& operator=(const CachedArea& other)
+    {
+        Base::operator=(other);
+        cached_version = none;
+        return *this;
+    }
+
+    double  area()  const override
+    {
+        auto& self    = static_cast<const Derived&>(*this);
+        auto  version = self.version();
+        if (cached_version.load(std::memory_order_acquire) != version)
+        {
+            cached_area.store(self.compute_area(), std::memory_order_relaxed);
+            cached_version.store(version, std::memory_order_release);
+        }
+        return cached_area.load(std::memory_order_relaxed);
+    }
+};
+
+struct Polygon : object::cloneable_impl<Polygon, CachedArea<Polygon>>, object::versioned
+{
+    static inline int area_computations = 0;
+
+    std::vector<Point> vertices;
+
+    Polygon() = default;
+    Polygon(std::vector<Point> vertices) : vertices{std::move(vertices)}{}
+    Polygon(const Polygon&) = default;
+    Polygon(Polygon&&) = default;
+    Polygon& operator=(const Polygon&) = default;
+    Polygon& operator=(Polygon&&) = default;
+
+    ~Polygon() override
+    {
+        materialize_lazy_clones();
+    }
+
+    void move_vertex(std::size_t i, Point p)
+    {
+        modify();
+        vertices[i] = p;
+    }
+
+    double  compute_area()  const
+    {
+        ++area_computations;
+        auto twice_area = 0.;
+        for (auto i = 0u; i < vertices.size(); ++i)
+        {
+            auto& p = vertices[i];
+            auto& q = vertices[(i + 1) % vertices.size()];
+            twice_area += p.x * q.y - q.x * p.y;
+        }
+        return std::abs(twice_area) / 2;
+    }
+};
+
+struct SharedFigure : object::shared_cloneable<SharedFigure>
+{
+    virtual double  area()  const = 0;
+};
+
+struct SharedSquare : object::cloneable_impl<SharedSquare, SharedFigure>
+{
+    static inline int alive = 0;
+
+    double a = 0;
+
+    SharedSquare(double a = 0) : a{a}
+    {
+        ++alive;
+    }
+
+    SharedSquare(const SharedSquare& other) : cloneable_impl(other), a{other.a}
+    {
+        ++alive;
+    }
+
+    ~SharedSquare() override
+    {
+        --alive;
+    }
+
+    double  area()  const override
+    {
+        return a * a;
+    }
+};
+
+struct ColoredSquare : object::cloneable_impl<ColoredSquare, Square>
+{
+    int color = 0;
+
+    ColoredSquare(double a, int color) : cloneable_impl(a), color{color}{}
+};
+
+// figure made of figures it does not own - children may be shared or form cycle
+struct Group : object::cloneable_impl<Group, Figure>, object::composite
+{
+    std::vector<const Figure*> children;
+
+    Group() = default;
+    Group(std::initializer_list<const Figure*> children) : children{children}{}
+
+    double area() const override
+    {
+        return std::accumulate(children.begin(), children.end(), 0., [](double sum, const Figure* child) { return sum + child->area(); });
+    }
+
+protected:
+    void relink(object::clone_context& context) override
+    {
+        for (auto& child : children)
+            child = &context.clone(*child);
+    }
+};
+
+// figure without vtable - only usable as alternative of closed_figure
+struct Rectangle
+{
+    double a = 0;
+    double b = 0;
+
+    double area() const
+    {
+        return a * b;
+    }
+};
+
+// closed_figure lives in namespace object so object::clone calls made anywhere in it,
+// e.g. inside clone_all, find overloads below through argument dependent lookup
+namespace object
+{
+    // figure of type known at compile time to be one of Ts - stored by value, area() dispatches
+    // through std::visit jump table and object::clone is value copy
+    template<typename... Ts>
+    class closed_figure
+    {
+        std::variant<Ts...> figure;
+
+    public:
+        template<typename T, typename = typename std::enable_if<(std::is_same<typename std::decay<T>::type, Ts>::value || ...)>::type>
+        closed_figure(T&& figure) : figure{std::forward<T>(figure)}{}
+
+        double area() const
+        {
+            return std::visit([](const auto& figure)
+            {
+                using type = typename std::decay<decltype(figure)>::type;
+                return figure.type::area();     // qualified call - no virtual dispatch even for Square
+            }, figure);
+        }
+
+        template<typename T>
+        bool holds() const
+        {
+            return std::holds_alternative<T>(figure);
+        }
+    };
+
+    template<typename... Ts>
+    closed_figure<Ts...> clone(const closed_figure<Ts...>& object)
+    {
+        return object;
+    }
+
+    template<typename... Ts>
+    closed_figure<Ts...> clone(closed_figure<Ts...>&& object)
+    {
+        return std::move(object);
+    }
+
+    template<typename... Ts>
+    closed_figure<Ts...> clone(const closed_figure<Ts...>* object)
+    {
+        return *object;
+    }
+
+    template<typename... Ts>
+    closed_figure<Ts...> clone(closed_figure<Ts...>* object)
+    {
+        return *object;
+    }
+}
+
+using object::closed_figure;
+
+// computes areas of count figures of one dynamic type
+using area_kernel = void (*)(const Figure* const* figures, std::size_t count, double* areas);
+
+inline std::unordered_map<std::type_index, area_kernel>& area_kernels()
+{
+    static std::unordered_map<std::type_index, area_kernel> kernels;
+    return kernels;
+}
+
+// figures of exactly type T get area() through qualified call - no indirect branch in loop
+template<typename T>
+void add_area_kernel()
+{
+    area_kernels()[typeid(T)] = [](const Figure* const* figures, std::size_t count, double* areas)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+            areas[i] = static_cast<const T*>(figures[i])->T::area();
+    };
+}
+
+// area of every figure pointed by [first, last) written to out in range order -
+// figures are evaluated per dynamic type, types without kernel through virtual area()
+template<typename ForwardIt, typename OutputIt>
+OutputIt areas(ForwardIt first, ForwardIt last, OutputIt out)
+{
+    std::vector<double> results(std::distance(first, last));
+    std::vector<double> sorted;
+    object::for_each_sorted(first, last, [&](const std::type_info& type, const Figure* const* figures, const std::size_t* positions, std::size_t count)
+    {
+        sorted.resize(count);
+        auto kernel = area_kernels().find(type);
+        if (kernel != area_kernels().end())
+            kernel->second(figures, count, sorted.data());
+        else
+            for (std::size_t i = 0; i < count; ++i)
+                sorted[i] = figures[i]->area();
+        for (std::size_t i = 0; i < count; ++i)
+            results[positions[i]] = sorted[i];
+    });
+    return std::copy(results.begin(), results.end(), out);
+}
+
+inline const bool square_area_kernel  = (add_area_kernel<Square>(), true);
+inline const bool polygon_area_kernel = (add_area_kernel<Polygon>(), true);
+
+namespace object
+{
+    template<>
+    struct trivially_droppable<FinalSquare> : std::true_type{};
+}
+
+// keeps figures by value - one packed array of parameters per concrete type,
+// kernels are chosen at run time from instruction sets supported by cpu
+class FigureStore
+{
+    std::vector<double> square_sides;
+
+public:
+    enum class kernel { scalar, avx2, avx512 };
+
+    static bool supports(kernel used)
+    {
+#if defined(FIGURE_STORE_SIMD)
+        switch (used)
+        {
+            case kernel::avx2:   return __builtin_cpu_supports("avx2");
+            case kernel::avx512: return __builtin_cpu_supports("avx512f");
+            default:             return true;
+        }
+#else
+        return used == kernel::scalar;
+#endif
+    }
+
+    static kernel best_kernel()
+    {
+        static const kernel best = supports(kernel::avx512) ? kernel::avx512
+                                 : supports(kernel::avx2)   ? kernel::avx2
+                                                            : kernel::scalar;
+        return best;
+    }
+
+    void add(const Square& square)
+    {
+        square_sides.push_back(square.a);
+    }
+
+    std::size_t size() const
+    {
+        return square_sides.size();
+    }
+
+    // used kernel has to be supported
+    double total_area(kernel used = best_kernel()) const
+    {
+        auto x = square_sides.data();
+        auto n = square_sides.size();
+        switch (used)
+        {
+#if defined(FIGURE_STORE_SIMD)
+            case kernel::avx512: return sum_of_squares_avx512(x, n);
+            case kernel::avx2:   return sum_of_squares_avx2(x, n);
+#endif
+            default:             return sum_of_squares(x, 0, n, 0.);
+        }
+    }
+
+    // writes area of every figure to out[0 .. size()) - squares first
+    void areas(double* out, kernel used = best_kernel()) const
+    {
+        auto x = square_sides.data();
+        auto n = square_sides.size();
+        switch (used)
+        {
+#if defined(FIGURE_STORE_SIMD)
+            case kernel::avx512: return squares_avx512(x, n, out);
+            case kernel::avx2:   return squares_avx2(x, n, out);
+#endif
+            default:             return squares(x, 0, n, out);
+        }
+    }
+
+private:
+    // scalar tails start at i
+    static double sum_of_squares(const double* x, std::size_t i, std::size_t n, double total)
+    {
+        for (; i < n; ++i)
+            total += x[i] * x[i];
+        return total;
+    }
+
+    static void squares(const double* x, std::size_t i, std::size_t n, double* out)
+    {
+        for (; i < n; ++i)
+            out[i] = x[i] * x[i];
+    }
+
+#if defined(FIGURE_STORE_SIMD)
+    __attribute__((target("avx512f")))
+    static double sum_of_squares_avx512(const double* x, std::size_t n)
+    {
+        std::size_t i = 0;
+        auto sum = _mm512_setzero_pd();
+        for (; i + 8 <= n; i += 8)
+        {
+            auto v = _mm512_loadu_pd(x + i);
+            sum = _mm512_add_pd(sum, _mm512_mul_pd(v, v));
+        }
+        double lanes[8];
+        _mm512_storeu_pd(lanes, sum);
+        return sum_of_squares(x, i, n, ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) +
+                                       ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7])));
+    }
+
+    __attribute__((target("avx2")))
+    static double sum_of_squares_avx2(const double* x, std::size_t n)
+    {
+        std::size_t i = 0;
+        auto sum = _mm256_setzero_pd();
+        for (; i + 4 <= n; i += 4)
+        {
+            auto v = _mm256_loadu_pd(x + i);
+            sum = _mm256_add_pd(sum, _mm256_mul_pd(v, v));
+        }
+        double lanes[4];
+        _mm256_storeu_pd(lanes, sum);
+        return sum_of_squares(x, i, n, (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]));
+    }
+
+    __attribute__((target("avx512f")))
+    static void squares_avx512(const double* x, std::size_t n, double* out)
+    {
+        std::size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            auto v = _mm512_loadu_pd(x + i);
+            _mm512_storeu_pd(out + i, _mm512_mul_pd(v, v));
+        }
+        squares(x, i, n, out);
+    }
+
+    __attribute__((target("avx2")))
+    static void squares_avx2(const double* x, std::size_t n, double* out)
+    {
+        std::size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            auto v = _mm256_loadu_pd(x + i);
+            _mm256_storeu_pd(out + i, _mm256_mul_pd(v, v));
+        }
+        squares(x, i, n, out);
+    }
+#endif
+};
+
+// readers iterate immutable versions without locks, writers publish new version with atomic pointer swap -
+// only edited figures are cloned, others are shared between versions; replaced version is freed
+// after every reader which could see it has finished (epoch based reclamation)
+class FigureCollection
+{
+public:
+    using version = std::vector<std::shared_ptr<const Figure>>;
+
+    static constexpr std::size_t max_readers = 64;
+    static constexpr std::size_t max_nodes   = 8;
+    static constexpr std::size_t max_scans   = 4096;    // rounds over all reader slots before read() blocks
+
+    class reader
+    {
+        const FigureCollection*     collection;
+        std::atomic<std::uint64_t>* slot;
+        const version*              figures;
+
+        friend class FigureCollection;
+
+        reader(const FigureCollection* collection, std::atomic<std::uint64_t>* slot, const version* figures)
+            : collection{collection}, slot{slot}, figures{figures}{}
+
+    public:
+        reader(reader&& other) noexcept : collection{other.collection}, slot{other.slot}, figures{other.figures}
+        {
+            other.slot = nullptr;
+        }
+
+        reader(const reader&) = delete;
+        reader& operator=(const reader&) = delete;
+
+        ~reader()
+        {
+            if (slot)
+                collection->release(*slot);
+        }
+
+        const version& operator*() const
+        {
+            return *figures;
+        }
+
+        const version* operator->() const
+        {
+            return figures;
+        }
+
+        version::const_iterator begin() const
+        {
+            return figures->begin();
+        }
+
+        version::const_iterator end() const
+        {
+            return figures->end();
+        }
+    };
+
+    FigureCollection() : current{new version}{}
+
+    FigureCollection(const FigureCollection&) = delete;
+    FigureCollection& operator=(const FigureCollection&) = delete;
+
+    // no reader may outlive collection
+    ~FigureCollection()
+    {
+        delete current.load();
+        for (auto& old : retired)
+            delete old.figures;
+    }
+
+    // current version stays alive until returned reader is destroyed - when all max_readers slots stay taken
+    // for max_scans rounds read() blocks until a reader releases its slot
+    reader read() const
+    {
+        static thread_local const std::size_t start = std::hash<std::thread::id>{}(std::this_thread::get_id()) % max_readers;
+        for (std::size_t scan = 0;; ++scan)
+        {
+            for (std::size_t i = 0; i < max_readers; ++i)
+            {
+                auto& slot = slots[(start + i) % max_readers].epoch;
+                auto  free = std::uint64_t{0};
+                if (slot.load(std::memory_order_relaxed) == 0 && slot.compare_exchange_strong(free, epoch.load()))
+                {
+                    count_read(slots[(start + i) % max_readers]);
+                    return reader{this, &slot, current.load()};
+                }
+            }
+            if (scan < max_scans)
+                std::this_thread::yield();
+            else
+                wait_for_slot();
+        }
+    }
+
+    void add(const Figure& figure)
+    {
+        publish([&](version& figures)
+        {
+            figures.push_back(object::clone(figure));
+        });
+    }
+
+    // edit(Figure&) changes clone of figure at index which replaces it in next version
+    template<typename Edit>
+    void update(std::size_t index, Edit edit)
+    {
+        publish([&](version& figures)
+        {
+            std::shared_ptr<Figure> figure = object::clone(*figures.at(index));
+            edit(*figure);
+            figures[index] = std::move(figure);
+        });
+    }
+
+    void erase(std::size_t index)
+    {
+        publish([&](version& figures)
+        {
+            figures.erase(figures.begin() + index);
+        });
+    }
+
+    // re-clones figures living away from node whose threads read collection most since last rebalance,
+    // returns number of moved figures - without reads since then nothing is moved
+    std::size_t rebalance()
+    {
+        auto reads = std::array<std::uint64_t, max_nodes>{};
+        for (auto& slot : slots)
+            for (std::size_t node = 0; node < max_nodes; ++node)
+                reads[node] += slot.reads[node].exchange(0, std::memory_order_relaxed);
+        if (std::accumulate(reads.begin(), reads.end(), std::uint64_t{0}) == 0)
+            return 0;
+        auto busiest = int(std::max_element(reads.begin(), reads.end()) - reads.begin());
+
+        auto moved = std::size_t{0};
+        publish([&](version& figures)
+        {
+            for (auto& figure : figures)
+            {
+                auto node = object::numa::node_of(dynamic_cast<const void*>(figure.get()));
+                if (node >= 0 && node != busiest)
+                {
+                    figure = object::clone(*figure, object::numa_placement::on_node(busiest));
+                    ++moved;
+                }
+            }
+        });
+        return moved;
+    }
+
+private:
+    struct retired_version
+    {
+        const version* figures;
+        std::uint64_t  epoch;   // last epoch in which version could be read
+    };
+
+    // own cache lines so readers of different slots do not share them
+    struct alignas(64) reader_slot
+    {
+        std::atomic<std::uint64_t>                        epoch{0};     // announced by reader, 0 when free
+        std::array<std::atomic<std::uint64_t>, max_nodes> reads{};      // reads per node of cpu, rebalance() hint
+    };
+
+    // waiter count is incremented before slots are checked and read after slot is freed,
+    // so either waiter sees free slot or releaser sees waiter and wakes it
+    void wait_for_slot() const
+    {
+        std::unique_lock<std::mutex> lock{waiting};
+        ++waiters;
+        released.wait(lock, [&]
+        {
+            return std::any_of(slots.begin(), slots.end(), [](const reader_slot& slot) { return slot.epoch.load() == 0; });
+        });
+        --waiters;
+    }
+
+    void release(std::atomic<std::uint64_t>& slot) const
+    {
+        slot.store(0);
+        if (waiters.load())
+        {
+            std::lock_guard<std::mutex> lock{waiting};
+            released.notify_all();
+        }
+    }
+
+    // only holder of slot writes its counts, so no read-modify-write is needed -
+    // a read counted while rebalance() collects may be lost
+    static void count_read(reader_slot& slot)
+    {
+        auto& count = slot.reads[std::min(object::numa::current_node(), int(max_nodes) - 1)];
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    template<typename Edit>
+    void publish(Edit edit)
+    {
+        std::lock_guard<std::mutex> lock{writer};
+        auto next = std::unique_ptr<version>(new version(*current.load()));
+        edit(*next);
+        auto previous = current.exchange(next.release());
+        retired.push_back(retired_version{previous, epoch.fetch_add(1)});
+        reclaim();
+    }
+
+    void reclaim()
+    {
+        auto oldest = ~std::uint64_t{0};
+        for (auto& slot : slots)
+            if (auto announced = slot.epoch.load())
+                oldest = std::min(oldest, announced);
+
+        auto safe = std::partition(retired.begin(), retired.end(), [&](const retired_version& old)
+        {
+            return old.epoch >= oldest;
+        });
+        for (auto it = safe; it != retired.end(); ++it)
+            delete it->figures;
+        retired.erase(safe, retired.end());
+    }
+
+    std::atomic<const version*>                               current;
+    mutable std::atomic<std::uint64_t>                        epoch{1};
+    mutable std::array<reader_slot, max_readers>              slots;
+    mutable std::mutex                                        waiting;      // readers blocked until slot is released
+    mutable std::condition_variable                           released;
+    mutable std::atomic<std::size_t>                          waiters{0};
+    std::mutex                                                writer;
+    std::vector<retired_version>                              retired;
+};
+
+} // v5 namespace
+
+#endif // FIGURES_V5_H
@@ -0,0 +1,47 @@
+#ifndef HEAP_TRACKING_H
+#define HEAP_TRACKING_H
+
+#include <gmock/gmock.h>
+#include <cstddef>
+
+// global operator new/delete are replaced in HeapTracking.cpp - they count calls made by each thread
+namespace heap_tracking
+{
+    std::size_t allocations();
+    std::size_t deallocations();
+}
+
+// allocations() and deallocations() count global heap calls of test thread since test started
+class HeapTracking : public ::testing::Test
+{
+    std::size_t allocations_before   = 0;
+    std::size_t deallocations_before = 0;
+
+protected:
+    void SetUp() override
+    {
+        allocations_before   = heap_tracking::allocations();
+        deallocations_before = heap_tracking::deallocations();
+    }
+
+    std::size_t allocations() const
+    {
+        return heap_tracking::allocations() - allocations_before;
+    }
+
+    std::size_t deallocations() const
+    {
+        return heap_tracking::deallocations() - deallocations_before;
+    }
+
+    // global allocations made while calling action()
+    template<typename Action>
+    std::size_t allocations_of(Action&& action) const
+    {
+        auto before = heap_tracking::allocations();
+        action();
+        return heap_tracking::allocations() - before;
+    }
+};
+
+#endif // HEAP_TRACKING_H
@@ -0,0 +1,142 @@
+#include "AllocationCounting.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    std::atomic<std::size_t> counted{0};
+
+    void* allocate(std::size_t size, std::size_t alignment)
+    {
+        counted.fetch_add(1, std::memory_order_relaxed);
+        size = size ? size : 1;
+        auto storage = alignment > alignof(std::max_align_t)
+                     ? std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment)
+                     : std::malloc(size);
+        if (!storage)
+            throw std::bad_alloc{};
+        return storage;
+    }
+
+    void* allocate_nothrow(std::size_t size, std::size_t alignment) noexcept
+    {
+        try
+        {
+            return allocate(size, alignment);
+        }
+        catch (const std::bad_alloc&)
+        {
+            return nullptr;
+        }
+    }
+}
+
+namespace allocation_counting
+{
+    std::size_t allocations()
+    {
+        return counted.load(std::memory_order_relaxed);
+    }
+}
+
+// every replaceable form is defined - standard library need not forward them to plain new and delete
+void* operator new(std::size_t size)
+{
+    return allocate(size, alignof(std::max_align_t));
+}
+
+void* operator new[](std::size_t size)
+{
+    return allocate(size, alignof(std::max_align_t));
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate_nothrow(size, alignof(std::max_align_t));
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate_nothrow(size, alignof(std::max_align_t));
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocate_nothrow(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocate_nothrow(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* storage) noexcept
+{
+    std::free(storage);
+}
+
+void operator delete[](void* storage) noexcept
+{
+    std::free(storage);
+}
+
+void operator delete(void* storage, std::size_t) noexcept
+{
+    std::free(storage);
+}
+
+void operator delete[](void* storage, std::size_t) noexcept
+{
+    std::free(storage);
+}
+
+void operator delete(void* storage, std::align_val_t) noexcept
+{
+    std::free(storage);
+}
+
+void operator delete[](void* storage, std::align_val_t) noexcept
+{
+    std::free(storage);
+}
+
+void operator delete(void* storage, std::size_t, std::align_val_t) noexcept
+{
+    std::free(storage);
+}
+
+void operator delete[](void* storage, std::size_t, std::align_val_t) noexcept
+{
+    std::free(storage);
+}
+
+void operator delete(void* storage, const std::nothrow_t&) noexcept
+{
+    std::free(storage);
+}
+
+void operator delete[](void* storage, const std::nothrow_t&) noexcept
+{
+    std::free(storage);
+}
+
+void operator delete(void* storage, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    std::free(storage);
+}
+
+void operator delete[](void* storage, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    std::free(storage);
+}
@@ -0,0 +1,13 @@
+#ifndef ALLOCATION_COUNTING_H
+#define ALLOCATION_COUNTING_H
+
+#include <cstddef>
+
+// global operator new/delete are replaced in AllocationCounting.cpp - they count calls made by all threads,
+// its own translation unit keeps them from being inlined into benchmarks
+namespace allocation_counting
+{
+    std::size_t allocations();
+}
+
+#endif // ALLOCATION_COUNTING_H
@@ -0,0 +1,573 @@
+#include <benchmark/benchmark.h>
+#include "../Figures-v5.h"
+#include "AllocationCounting.h"
+#include <array>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <type_traits>
+
+// designs of FigureTests-v1 .. v4 restated, v5 and closed_figure taken from Figures-v5.h,
+// all cloning Square<Depth, Bytes>: Depth classes between Figure and cloned type, Bytes of payload next to side
+
+struct static_type    {};
+struct base_reference {};
+struct base_pointer   {};
+
+template<typename T>
+void dispose(T* object)
+{
+    delete object;
+}
+
+template<typename T, typename Deleter>
+void dispose(std::unique_ptr<T, Deleter>& object)
+{
+    object.reset();
+}
+
+namespace v1 {
+
+struct Figure
+{
+    virtual ~Figure() = default;
+    virtual double  area()  const = 0;
+    virtual Figure* clone() const = 0;
+};
+
+template<std::size_t Depth, std::size_t Bytes>
+struct Square : Square<Depth - 1, Bytes>
+{
+    Square* clone() const override
+    {
+        return new Square(*this);
+    }
+};
+
+template<std::size_t Bytes>
+struct Square<1, Bytes> : Figure
+{
+    double a = 0;
+    std::array<unsigned char, Bytes> payload{};
+
+    double  area()  const override
+    {
+        return a * a;
+    }
+
+    Square* clone() const override
+    {
+        return new Square(*this);
+    }
+};
+
+struct design
+{
+    using figure = Figure;
+
+    template<std::size_t Depth, std::size_t Bytes>
+    using square = Square<Depth, Bytes>;
+
+    template<typename T>
+    static T* clone(static_type, const T& square)
+    {
+        return square.clone();
+    }
+
+    static Figure* clone(base_reference, const Figure& figure)
+    {
+        return figure.clone();
+    }
+
+    static Figure* clone(base_pointer, const Figure* figure)
+    {
+        return figure->clone();
+    }
+};
+
+} // v1 namespace
+
+namespace v2 {
+
+template<typename T>
+auto clone(const T& object) -> std::unique_ptr<T>
+{
+    return std::unique_ptr<T>(object.clone());
+}
+
+struct Figure
+{
+    using base_type = Figure;
+
+    virtual ~Figure() = default;
+    virtual double  area()  const = 0;
+
+    virtual Figure* clone() const = 0;
+};
+
+template<std::size_t Depth, std::size_t Bytes>
+struct Square : Square<Depth - 1, Bytes>
+{
+    Square* clone() const override
+    {
+        return new Square(*this);
+    }
+};
+
+template<std::size_t Bytes>
+struct Square<1, Bytes> : Figure
+{
+    double a = 0;
+    std::array<unsigned char, Bytes> payload{};
+
+    double  area()  const override
+    {
+        return a * a;
+    }
+
+    Square* clone() const override
+    {
+        return new Square(*this);
+    }
+};
+
+struct design
+{
+    using figure = Figure;
+
+    template<std::size_t Depth, std::size_t Bytes>
+    using square = Square<Depth, Bytes>;
+
+    template<typename T>
+    static std::unique_ptr<T> clone(static_type, const T& square)
+    {
+        return v2::clone(square);
+    }
+
+    static std::unique_ptr<Figure> clone(base_reference, const Figure& figure)
+    {
+        return v2::clone(figure);
+    }
+
+    static std::unique_ptr<Figure> clone(base_pointer, const Figure* figure)
+    {
+        return v2::clone(*figure);   // v2 has no pointer overload
+    }
+};
+
+} // v2 namespace
+
+namespace v3 {
+
+namespace object
+{
+    template<typename T>
+    std::unique_ptr<T> clone(const T& object)
+    {
+        return std::unique_ptr<T>(object.clone());
+    }
+
+    template<typename T>
+    auto clone(T* object) -> decltype(clone(*object))
+    {
+        return clone(*object);
+    }
+}
+
+struct Figure
+{
+    using base_type = Figure;
+
+    virtual ~Figure() = default;
+    virtual double  area()  const = 0;
+
+    virtual Figure* clone() const = 0;
+};
+
+template<std::size_t Depth, std::size_t Bytes>
+struct Square : Square<Depth - 1, Bytes>
+{
+    Square* clone() const override
+    {
+        return new Square(*this);
+    }
+};
+
+template<std::size_t Bytes>
+struct Square<1, Bytes> : Figure
+{
+    double a = 0;
+    std::array<unsigned char, Bytes> payload{};
+
+    double  area()  const override
+    {
+        return a * a;
+    }
+
+    Square* clone() const override
+    {
+        return new Square(*this);
+    }
+};
+
+struct design
+{
+    using figure = Figure;
+
+    template<std::size_t Depth, std::size_t Bytes>
+    using square = Square<Depth, Bytes>;
+
+    template<typename T>
+    static std::unique_ptr<T> clone(static_type, const T& square)
+    {
+        return object::clone(square);
+    }
+
+    static std::unique_ptr<Figure> clone(base_reference, const Figure& figure)
+    {
+        return object::clone(figure);
+    }
+
+    static std::unique_ptr<const Figure> clone(base_pointer, const Figure* figure)
+    {
+        return object::clone(figure);
+    }
+};
+
+} // v3 namespace
+
+namespace v4 {
+
+namespace object
+{
+    template<typename T>
+    std::unique_ptr<T> clone(const T& object)
+    {
+        using base_type = typename T::base_type;
+        static_assert(std::is_base_of<base_type, T>::value, "T object has to derived from T::base_type");
+        auto ptr = static_cast<const base_type&>(object).clone();
+        return std::unique_ptr<T>(static_cast<T*>(ptr));
+    }
+
+    template<typename T>
+    auto clone(T* object) -> decltype(clone(*object))
+    {
+        return clone(*object);
+    }
+}
+
+struct Figure
+{
+    using base_type = Figure;
+
+    virtual ~Figure() = default;
+
+    virtual double  area()  const = 0;
+
+protected:
+    virtual Figure* clone() const = 0;
+
+    template <typename T>
+    friend std::unique_ptr<T> object::clone(const T&);
+};
+
+template<std::size_t Depth, std::size_t Bytes>
+struct Square : Square<Depth - 1, Bytes>
+{
+protected:
+    Square* clone() const override
+    {
+        return new Square(*this);
+    }
+};
+
+template<std::size_t Bytes>
+struct Square<1, Bytes> : Figure
+{
+    double a = 0;
+    std::array<unsigned char, Bytes> payload{};
+
+    double  area()  const override
+    {
+        return a * a;
+    }
+
+protected:
+    Square* clone() const override
+    {
+        return new Square(*this);
+    }
+};
+
+struct design
+{
+    using figure = Figure;
+
+    template<std::size_t Depth, std::size_t Bytes>
+    using square = Square<Depth, Bytes>;
+
+    template<typename T>
+    static std::unique_ptr<T> clone(static_type, const T& square)
+    {
+        return object::clone(square);
+    }
+
+    static std::unique_ptr<Figure> clone(base_reference, const Figure& figure)
+    {
+        return object::clone(figure);
+    }
+
+    static std::unique_ptr<const Figure> clone(base_pointer, const Figure* figure)
+    {
+        return object::clone(figure);
+    }
+};
+
+} // v4 namespace
+
+namespace v5_figures {
+
+namespace object = v5::object;
+
+using v5::Figure;
+
+template<std::size_t Depth, std::size_t Bytes>
+struct Square : object::cloneable_impl<Square<Depth, Bytes>, Square<Depth - 1, Bytes>>
+{
+};
+
+template<std::size_t Bytes>
+struct Square<1, Bytes> : object::cloneable_impl<Square<1, Bytes>, Figure>
+{
+    double a = 0;
+    std::array<unsigned char, Bytes> payload{};
+
+    double  area()  const override
+    {
+        return a * a;
+    }
+};
+
+// object::clone copies final leaf without virtual call
+template<std::size_t Depth, std::size_t Bytes>
+struct FinalSquare final : object::cloneable_impl<FinalSquare<Depth, Bytes>, Square<Depth, Bytes>>
+{
+};
+
+template<std::size_t Depth, std::size_t Bytes>
+struct PooledSquare : object::cloneable_impl<PooledSquare<Depth, Bytes>, Square<Depth, Bytes>>,
+                      object::pooled<PooledSquare<Depth, Bytes>, object::thread_local_pool>
+{
+};
+
+} // v5_figures namespace
+
+namespace v5 {
+namespace object {
+
+template<std::size_t Depth, std::size_t Bytes>
+struct trivially_droppable<v5_figures::FinalSquare<Depth, Bytes>> : std::true_type{};
+
+} // object namespace
+} // v5 namespace
+
+namespace v5_figures {
+
+template<template<std::size_t, std::size_t> class SquareType>
+struct design
+{
+    using figure = Figure;
+
+    template<std::size_t Depth, std::size_t Bytes>
+    using square = SquareType<Depth, Bytes>;
+
+    template<typename T>
+    static std::unique_ptr<T> clone(static_type, const T& square)
+    {
+        return object::clone(square);
+    }
+
+    static std::unique_ptr<Figure> clone(base_reference, const Figure& figure)
+    {
+        return object::clone(figure);
+    }
+
+    static std::unique_ptr<const Figure> clone(base_pointer, const Figure* figure)
+    {
+        return object::clone(figure);
+    }
+};
+
+// clones of final leaf into memory resource and generation arena - storage is reused, not allocated per clone
+template<std::size_t Bytes>
+void clone_into_resource(benchmark::State& state)
+{
+    FinalSquare<1, Bytes> square;
+    std::pmr::unsynchronized_pool_resource pool;
+
+    auto before = allocation_counting::allocations();
+    for (auto _ : state)
+    {
+        auto copy = object::clone(square, pool);
+        benchmark::DoNotOptimize(copy);
+        copy.reset();
+    }
+
+    state.counters["allocations"] = benchmark::Counter(static_cast<double>(allocation_counting::allocations() - before),
+                                                       benchmark::Counter::kAvgIterations);
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * sizeof(square));
+}
+
+template<std::size_t Bytes>
+void clone_into_arena(benchmark::State& state)
+{
+    constexpr std::size_t generation = 1024;    // clones between arena resets
+    FinalSquare<1, Bytes> square;
+    object::generation_arena arena;
+
+    auto clones = std::size_t{0};
+    auto before = allocation_counting::allocations();
+    for (auto _ : state)
+    {
+        auto copy = object::clone(square, arena);
+        benchmark::DoNotOptimize(copy);
+        if (++clones % generation == 0)
+            arena.reset();
+    }
+
+    state.counters["allocations"] = benchmark::Counter(static_cast<double>(allocation_counting::allocations() - before),
+                                                       benchmark::Counter::kAvgIterations);
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * sizeof(square));
+}
+
+template<std::size_t Bytes>
+void register_storage_paths()
+{
+    auto prefix = "v5-final/depth:1/bytes:" + std::to_string(sizeof(FinalSquare<1, Bytes>));
+    benchmark::RegisterBenchmark((prefix + "/resource").c_str(), clone_into_resource<Bytes>);
+    benchmark::RegisterBenchmark((prefix + "/arena").c_str(),    clone_into_arena<Bytes>);
+}
+
+} // v5_figures namespace
+
+namespace closed {
+
+// alternative of v5::object::closed_figure - no vtable, clone is value copy
+template<std::size_t Bytes>
+struct Square
+{
+    double a = 0;
+    std::array<unsigned char, Bytes> payload{};
+
+    double  area()  const
+    {
+        return a * a;
+    }
+};
+
+template<std::size_t Bytes>
+using figure = v5::object::closed_figure<Square<Bytes>, v5::Rectangle>;
+
+template<std::size_t Bytes>
+void clone(benchmark::State& state)
+{
+    figure<Bytes> square{Square<Bytes>{}};
+    benchmark::DoNotOptimize(square);   // hide held alternative from optimizer
+
+    auto before = allocation_counting::allocations();
+    for (auto _ : state)
+    {
+        auto copy = v5::object::clone(square);
+        benchmark::DoNotOptimize(copy);
+    }
+
+    state.counters["allocations"] = benchmark::Counter(static_cast<double>(allocation_counting::allocations() - before),
+                                                       benchmark::Counter::kAvgIterations);
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * sizeof(figure<Bytes>));
+}
+
+template<std::size_t Bytes>
+void register_paths()
+{
+    auto prefix = "closed/depth:1/bytes:" + std::to_string(sizeof(figure<Bytes>));
+    benchmark::RegisterBenchmark((prefix + "/value").c_str(), clone<Bytes>);
+}
+
+} // closed namespace
+
+template<typename Design, typename Path, std::size_t Depth, std::size_t Bytes>
+void clone(benchmark::State& state)
+{
+    using square_type = typename Design::template square<Depth, Bytes>;
+    using figure_type = typename Design::figure;
+
+    square_type square;
+    const figure_type* figure = &square;
+    benchmark::DoNotOptimize(figure);   // hide dynamic type from optimizer
+
+    auto before = allocation_counting::allocations();
+    for (auto _ : state)
+    {
+        auto copy = [&]
+        {
+            if constexpr (std::is_same<Path, static_type>::value)
+                return Design::clone(Path{}, square);
+            else if constexpr (std::is_same<Path, base_reference>::value)
+                return Design::clone(Path{}, *figure);
+            else
+                return Design::clone(Path{}, figure);
+        }();
+        benchmark::DoNotOptimize(copy);
+        dispose(copy);
+    }
+
+    state.counters["allocations"] = benchmark::Counter(static_cast<double>(allocation_counting::allocations() - before),
+                                                       benchmark::Counter::kAvgIterations);
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * sizeof(square_type));
+}
+
+template<typename Design, std::size_t Depth, std::size_t Bytes>
+void register_paths(const std::string& name)
+{
+    auto prefix = name + "/depth:" + std::to_string(Depth) + "/bytes:" + std::to_string(sizeof(typename Design::template square<Depth, Bytes>));
+    benchmark::RegisterBenchmark((prefix + "/static_type").c_str(),    clone<Design, static_type,    Depth, Bytes>);
+    benchmark::RegisterBenchmark((prefix + "/base_reference").c_str(), clone<Design, base_reference, Depth, Bytes>);
+    benchmark::RegisterBenchmark((prefix + "/base_pointer").c_str(),   clone<Design, base_pointer,   Depth, Bytes>);
+}
+
+template<typename Design>
+void register_design(const std::string& name)
+{
+    register_paths<Design, 1, 0>(name);
+    register_paths<Design, 1, 240>(name);
+    register_paths<Design, 1, 4080>(name);
+    register_paths<Design, 4, 0>(name);
+    register_paths<Design, 16, 0>(name);
+}
+
+int main(int argc, char** argv)
+{
+    register_design<v1::design>("v1");
+    register_design<v2::design>("v2");
+    register_design<v3::design>("v3");
+    register_design<v4::design>("v4");
+    register_design<v5_figures::design<v5_figures::Square>>("v5");
+    register_design<v5_figures::design<v5_figures::FinalSquare>>("v5-final");
+    register_design<v5_figures::design<v5_figures::PooledSquare>>("v5-pooled");
+    v5_figures::register_storage_paths<0>();
+    v5_figures::register_storage_paths<240>();
+    v5_figures::register_storage_paths<4080>();
+    closed::register_paths<0>();
+    closed::register_paths<240>();
+    closed::register_paths<4080>();
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+}